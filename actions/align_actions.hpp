@@ -39,22 +39,31 @@ namespace model {
 
       void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
       {
-        const auto sv = sim.sorted_view<Tag>(idx);
-        const auto& flock = sim.pop<Tag>();
-        
-		    vec3 adir(0.f);
-        auto realized_topo = while_topo(sv, topo, [&](const auto& ni) {
-
-          if (in_fov(self, ni.dist2, flock[ni.idx].pos, this))
-          {
-            adir += flock[ni.idx].dir;
-            return true;
-          }
-          return false;
-        });
-
-		const vec3 Fdir = math::save_normalize(adir, vec3(0.f)) * w_; 
- 		self->steering += Fdir;
+        neighbor_walk(self, idx, sim, *this);
+        end(self);
+      }
+
+      bool begin(agent_type* self)
+      {
+        adir_ = vec3(0.f);
+        left_ = topo;
+        return left_ > 0;
+      }
+
+      bool visit(agent_type* self, const neighbor_ctx<agent_type>& nc)
+      {
+        if (nc.in_fov(*this))
+        {
+          adir_ += nc.dir;
+          return --left_ > 0;
+        }
+        return true;
+      }
+
+      void end(agent_type* self)
+      {
+        const vec3 Fdir = math::save_normalize(adir_, vec3(0.f)) * w_;
+        self->steering += Fdir;
       }
 
     public:
@@ -64,6 +73,8 @@ namespace model {
 
     private:
       float w_;           // [1]
+      vec3 adir_;         // accumulator
+      int left_ = 0;
     }; 
 
   }
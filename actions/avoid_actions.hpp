@@ -44,25 +44,32 @@ namespace model {
 
       void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
       {
-        const auto sv = sim.sorted_view<Tag>(idx);
-        const auto& flock = sim.pop<Tag>();
-
-        auto ofss = vec3(0);
-        auto realized_topo = while_topo(sv, topo, [&](const auto& ni) {
-
-          if (in_fov(self, ni.dist2, flock[ni.idx].pos, this))
-          {
-            if (ni.dist2 < minsep2)
-            {
-				ofss += space::ofs(flock[ni.idx].pos, self->pos);
-              return true;
-            }
-          }
-          return false;
-        });
-
-		const vec3 Fdir = math::save_normalize(ofss, vec3(0.f)) * w_;
-		self->steering += Fdir;
+        neighbor_walk(self, idx, sim, *this);
+        end(self);
+      }
+
+      bool begin(agent_type* self)
+      {
+        ofss_ = vec3(0);
+        left_ = topo;
+        return left_ > 0;
+      }
+
+      bool visit(agent_type* self, const neighbor_ctx<agent_type>& nc)
+      {
+        if (nc.ni.dist2 >= minsep2) return false;   // sorted row
+        if (nc.in_fov(*this))
+        {
+          ofss_ += space::ofs(nc.pos, self->pos);
+          return --left_ > 0;
+        }
+        return true;
+      }
+
+      void end(agent_type* self)
+      {
+        const vec3 Fdir = math::save_normalize(ofss_, vec3(0.f)) * w_;
+        self->steering += Fdir;
       }
 
        public:
@@ -72,6 +79,8 @@ namespace model {
         float maxdist2 = 0;     // [m^2]
     private:
         float w_;               // [1]
+        vec3 ofss_;             // accumulator
+        int left_ = 0;
       };
 
   }
@@ -18,7 +18,7 @@ namespace model {
 
 	public:
 		random_t_turn_gamma_pred() {}
-		random_t_turn_gamma_pred(size_t, const json& J)
+		random_t_turn_gamma_pred(size_t, const json& J, const Simulation& sim)
 		{
 			const float turn_mean = glm::radians(float(J["turn_mean"]));
 			const float turn_sd = glm::radians(float(J["turn_sd"]));
@@ -36,7 +36,7 @@ namespace model {
 			turn_distr_ = std::gamma_distribution<float>(turn_alpha, turn_beta);
 			time_distr_ = std::gamma_distribution<float>(time_alpha, time_beta);
 
-			turn_dur_ = static_cast<tick_t>(turn_mean / Simulation::dt());
+			turn_dur_ = static_cast<tick_t>(turn_mean / sim.dt());
 		}
 		void check_state_exit(const tick_t& state_dur, tick_t& state_exit_t)
 		{
@@ -53,18 +53,19 @@ namespace model {
 				thisturn = turn_distr_(model::reng);
 			} while ( loc_time * thisturn <= 0.f ); // both not 0
 
-			turn_dur_ = static_cast<tick_t>(static_cast<double>(loc_time) / Simulation::dt());
+			turn_dur_ = static_cast<tick_t>(static_cast<double>(loc_time) / sim.dt());
 
 			auto w = thisturn / loc_time;       // required angular velocity
 			r_ = self->speed / w;       // radius
 
 			// find direction away from predator
-			const auto nv = sim.sorted_view<Tag, pred_tag>(idx);
+			const auto nv = sim.nearest<Tag, pred_tag>(idx);
 
 			if (nv.size())
 			{
-				const auto& predator = sim.pop<pred_tag>()[nv[0].idx];    // nearest predator
-				const float rad_away_pred = math::rad_between_xy(predator.dir, self->dir);
+				// nearest predator, as of the last tick: predators update concurrently
+				const auto pred_dir = sim.kin<pred_tag>().dir(nv[0].idx);
+				const float rad_away_pred = math::rad_between_xy(pred_dir, self->dir);
 				w_ = std::copysignf(1.f, rad_away_pred);
 			}
 			else
@@ -82,6 +83,8 @@ namespace model {
 
 		}
 
+		void run_state(archive& ar) { ar(r_, turn_dir_, turn_dur_, w_); }
+
 	private:
 		float r_ = 0;
 		vec3 turn_dir_;
@@ -120,29 +123,49 @@ namespace model {
 
 			void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
-					const auto sv = sim.sorted_view<Tag>(idx);
-					const auto& flock = sim.pop<Tag>();
+					neighbor_walk(self, idx, sim, *this);
+					end(self);
+			}
 
-					tick_t time_left = 0;
-					int state2copy = 0;
+			// first 'topo' neighbors
+			bool begin(agent_type* self)
+			{
+					time_left_ = 0;
+					state2copy_ = 0;
+					left_ = topo;
+					return left_ > 0;
+			}
 
-					for (auto it = sv.cbegin(); it != sv.cbegin() + topo; ++it) {
-							if (in_fov(self, it->dist2, flock[it->idx].pos, this) && it->is_esc)
+			bool visit(agent_type* self, const neighbor_ctx<agent_type>& nc)
+			{
+					if (nc.in_fov(*this))
+					{
+							const auto state = nc.other.get_current_state();
+							if (nc.sim.is_esc_state(state))
 							{
-									time_left = it->esc_t_left;
-									state2copy = it->state;
-									break;
+									time_left_ = nc.other.state_timer;
+									state2copy_ = state;
+									return false;
 							}
 					}
+					return --left_ > 0;
+			}
 
-					self->copy_duration = time_left;
-					self->copy_state = state2copy;
+			void end(agent_type* self)
+			{
+					self->copy_duration = time_left_;
+					self->copy_state = state2copy_;
 			}
 
 	public:
 			int topo = 0;           // [1]
 			float cfov = 0;         // [1]
 			float maxdist2 = 0;     // [m^2]
+
+	private:
+			tick_t time_left_ = 0;
+			int state2copy_ = 0;
+			int left_ = 0;
 	};
 
   }
@@ -40,24 +40,32 @@ namespace model {
 
       void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
       {
-        const auto sv = sim.sorted_view<Tag>(idx);
-        const auto& flock = sim.pop<Tag>();
-
-        auto ofss = vec3(0.f);
-        auto n = 0.f; // number of neighbors
-        auto realized_topo = while_topo(sv, topo, [&](const auto& ni) {
-
-          if (in_fov(self, ni.dist2, flock[ni.idx].pos, this))
-          {
-            ofss += space::ofs(self->pos, flock[ni.idx].pos);
-            ++n;
-            return true;
-          }
-          return false;
-        });
-
-        const auto w_scaled = (realized_topo) ? w_ * glm::length(ofss / n) : 0.f; // math::smootherstep(glm::length(ofss / n), min_w_dist_, max_w_dist_);
-        const auto Fdir =  math::save_normalize(ofss, vec3(0.f)) * w_scaled;
+        neighbor_walk(self, idx, sim, *this);
+        end(self);
+      }
+
+      bool begin(agent_type* self)
+      {
+        ofss_ = vec3(0.f);
+        n_ = 0.f;
+        return topo > 0;
+      }
+
+      bool visit(agent_type* self, const neighbor_ctx<agent_type>& nc)
+      {
+        if (nc.in_fov(*this))
+        {
+          ofss_ += nc.offs;
+          ++n_;
+          return n_ < topo;
+        }
+        return true;
+      }
+
+      void end(agent_type* self)
+      {
+        const auto w_scaled = (n_ > 0.f) ? w_ * glm::length(ofss_ / n_) : 0.f; // math::smootherstep(glm::length(ofss / n), min_w_dist_, max_w_dist_);
+        const auto Fdir =  math::save_normalize(ofss_, vec3(0.f)) * w_scaled;
         self->steering += Fdir;
       }
 
@@ -68,6 +76,8 @@ namespace model {
 
     private:
       float w_ = 0;           // [1]
+      vec3 ofss_;             // accumulator
+      float n_ = 0.f;         // number of neighbors
      // float max_w_dist_;      // [m]
      // float min_w_dist_;      // [m]
     };
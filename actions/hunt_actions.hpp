@@ -31,7 +31,7 @@ namespace model {
 
 			void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
-				const auto sv = sim.sorted_view<Tag, starling_tag>(idx);
+				const auto sv = sim.nearest<Tag, starling_tag>(idx);
 
 				if (sv.size())
 				{ 
@@ -62,15 +62,15 @@ namespace model {
 			{
 				w_ = J["w"];                       // [1]
 				prey_speed_scale_ = J["prey_speed_scale"];                       // [1]
-				target_idx_ = -1;
+				target_id_ = -1;
 			}
 
 			void on_entry(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
-				const auto sv = sim.sorted_view<Tag, starling_tag>(idx);
+				const auto sv = sim.nearest<Tag, starling_tag>(idx);
 				if (sv.size())
 				{
-					target_idx_ = sv[0].idx; // nearest prey
+					target_id_ = sim.id_of<starling_tag>(sv[0].idx); // nearest prey
 				}
 			}
 
@@ -80,9 +80,9 @@ namespace model {
 
 			void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
-				if (target_idx_ != -1)
+				if (target_id_ != -1)
 				{
-					const auto& target = sim.pop<starling_tag>()[target_idx_]; // nearest prey
+					const auto& target = sim.pop<starling_tag>()[sim.idx_of<starling_tag>(target_id_)]; // nearest prey
 					auto ofss = space::ofs(self->pos, target.pos);;
 
 					const auto Fdir = math::save_normalize(ofss, vec3(0.f)) * w_;
@@ -91,10 +91,12 @@ namespace model {
 				}
 			}
 
+			void run_state(archive& ar) { ar(target_id_); }
+
 		private:
 			float w_ = 0;           // [1]
 			float prey_speed_scale_ = 0; // speed in relation to the preys speed [1]
-			size_t target_idx_ = 0; //
+			size_t target_id_ = 0; // external id
 		};
 
 
@@ -121,7 +123,7 @@ namespace model {
 
 			void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
-				const auto sv = sim.sorted_view<Tag, starling_tag>(idx);
+				const auto sv = sim.nearest<Tag, starling_tag>(idx);
 
 				if (sv.size())
 				{
@@ -73,6 +73,8 @@ namespace model {
 				self->steering += Fdir;
 			}
 
+			void run_state(archive& ar) { ar(pos_); }
+
 		public:
 			vec3 pos_;
 			float w_;
@@ -125,12 +127,17 @@ namespace model {
 				auto it = flocks.cend();
 
 				switch (selection_) {
-				case Selection::Nearest:
-					it = std::min_element(flocks.cbegin(), flocks.cend(), [pos = self->pos](const auto& a, const auto& b) {
-						return glm::distance2(a.gc(), pos) <
-							glm::distance2(b.gc(), pos);
-					});
+				case Selection::Nearest: {
+					auto best = std::numeric_limits<float>::max();
+					for (size_t i = 0; i < flocks.size(); ++i) {
+						const auto d2 = glm::distance2(sim.flock_shape<starling_tag>(i).gc(), self->pos);
+						if (d2 < best) {
+							best = d2;
+							it = flocks.cbegin() + i;
+						}
+					}
 					break;
+				}
 				case Selection::Biggest:
 					it = std::max_element(flocks.cbegin(), flocks.cend(), [](const auto& a, const auto& b) {
 						return a.size < b.size;
@@ -152,8 +159,7 @@ namespace model {
 				}
 				self->target = -1;
 				if (it != flocks.cend()) {
-					const auto flock_id = static_cast<size_t>(std::distance(flocks.cbegin(), it));
-					self->target = sim.flock_mates<starling_tag>(flock_id)[0];
+					self->target = static_cast<int>(sim.id_of<starling_tag>(it->rep));
 				}
 			}
 
@@ -180,7 +186,7 @@ namespace model {
 			void on_entry(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
 				if (placement_) {
-					const auto& target = sim.pop<starling_tag>()[self->target];
+					const auto& target = sim.pop<starling_tag>()[sim.idx_of<starling_tag>(self->target)];
 					self->pos = target.pos + dist_ * math::rotate_xy(target.dir, bearing_);
 					self->dir = target.dir;
 				}
@@ -193,7 +199,7 @@ namespace model {
 			void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
 			{
 				if (-1 != self->target) {
-					const auto& target = sim.pop<starling_tag>()[self->target];
+					const auto& target = sim.pop<starling_tag>()[sim.idx_of<starling_tag>(self->target)];
 					const auto pos = target.pos + dist_ * math::rotate_xy(target.dir, bearing_);
 					const auto ofs = space::ofs(self->pos, pos);
 					const auto Fdir = math::save_normalize(ofs, self->dir);
@@ -24,7 +24,7 @@ namespace model {
 			{
 				// homing position relative to its flock current position
 				const auto& this_flock = sim.flocks<Tag>()[sim.flock_of<Tag>(idx)];
-				const auto& flock_pos = this_flock.gc();
+				const auto flock_pos = sim.flock_shape<Tag>(sim.flock_of<Tag>(idx)).gc();
 				const auto& flock_head = math::save_normalize(this_flock.vel, vec3(0.f));
 				home_pos_ = flock_pos + dist_to_home_ * math::rotate_xy(flock_head, angl_to_home_);
 			}
@@ -40,6 +40,8 @@ namespace model {
 				self->steering += Fdir;
 			}
 
+			void run_state(archive& ar) { ar(home_pos_); }
+
 		private:
 			vec3 home_pos_ = { 0,0,0 };  // []
 			float dist_to_home_ = 0;    // [m]
@@ -40,6 +40,21 @@ namespace model {
   struct known_color_maps<pred_tag>;
 
 
+  // species whose neighborhoods the agents of species Tag read
+  // (Simulation::sorted_view, raw_view). neighbor matrices of other
+  // species pairs are neither allocated nor computed.
+  template <typename Tag>
+  struct neighbor_species {
+    using type = std::tuple<>;
+  };
+
+  template <>
+  struct neighbor_species<starling_tag>;
+
+  template <>
+  struct neighbor_species<pred_tag>;
+
+
   template <typename Tag>
   struct snapshot_entry {};
   
@@ -10,7 +10,6 @@ namespace model {
 
   // Predator
 
-  decltype(Pred::transitions_) Pred::transitions_;
   // flight::aero_info<float> Pred::ai;
   //const flight::aero_info<float>& Pred::ai = Pred::ai;
 
@@ -39,25 +38,23 @@ namespace model {
 
 
 
-  Pred::Pred(size_t idx, const json& J) :
+  Pred::Pred(size_t idx, const json& J, const Simulation& sim) :
     current_state_(0),
     state_timer(0), 
     pos(0, 0, 0),
     dir(1, 0, 0),
     accel(0) // [m / s^2]
   {
-    if (idx == 0) {
-      transitions_ = decltype(transitions_)(J);
-    }
+    transitions_ = (idx == 0) ? std::make_shared<const transitions>(J) : sim.pop<Tag>().front().transitions_;
     ai = flight::create_aero_info<float>(J["aero"]);
     speed = sa.cruiseSpeed = ai.cruiseSpeed;
     sa.w = 0.f; // until they get value from state? (first integrates before update)
-    pa_ = AP::create(idx, J["states"]);
+    pa_ = AP::create(idx, J["states"], sim);
   }
 
   void Pred::initialize(size_t idx, const Simulation& sim, const json& J)
   {
-    pa_[current_state_]->enter(this, idx, 0, sim);
+    pa_[current_state_]->enter(this, idx, sim.tick(), sim);
   }
 
   ::model::instance_proxy Pred::instance_proxy(long long color_map, size_t idx, const Simulation* sim) const noexcept
@@ -84,6 +81,14 @@ namespace model {
     accel = se.accel;
   }
 
+  void Pred::checkpoint(archive& ar)
+  {
+    ar(pos, dir, ang_vel, reaction_time, last_update, copy_duration, speed, accel, force, steering);
+    ar(target, state_timer, copy_state, sa, current_state_);
+    if (ar.parameters()) ar(ai);
+    for (auto& s : pa_) s->checkpoint(ar);
+  }
+
   size_t Pred::update(size_t idx, tick_t T, const Simulation& sim)
   {
     steering = vec3(0);
@@ -94,14 +99,14 @@ namespace model {
 
   void Pred::integrate(tick_t T, const Simulation& sim)
   {
-    flight_control::integrate_motion(this);
+    flight_control::integrate_motion(this, sim.dt());
   }
 
   void Pred::on_state_exit(size_t idx, tick_t T, const Simulation& sim)
   {
     // select new state
     auto& dist = pred_discrete_dist;
-    const auto TM = transitions_(0.f);
+    const auto TM = (*transitions_)(0.f);
     pred_discrete_dist.mutate(TM[current_state_].cbegin(), TM[current_state_].cend());
     current_state_ = pred_discrete_dist(reng);
     pa_[current_state_]->enter(this, idx, T, sim);
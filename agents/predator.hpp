@@ -32,6 +32,13 @@ namespace model {
   };
 
 
+  template <>
+  struct neighbor_species<pred_tag>
+  {
+    using type = std::tuple<starling_tag>;   // hunting
+  };
+
+
   template <>
   struct snapshot_entry<pred_tag>
   {
@@ -94,7 +101,7 @@ namespace model {
 
   public:
     Pred(Pred&&) = default;
-    Pred(size_t idx, const json& J);
+    Pred(size_t idx, const json& J, const Simulation& sim);
     void initialize(size_t idx, const Simulation& sim, const json& J);
 
     // returns next update time
@@ -112,6 +119,7 @@ namespace model {
     ::model::instance_proxy instance_proxy(long long color_map, size_t idx, const class Simulation* sim) const noexcept;
     ::model::snapshot_entry<Tag> snapshot(const Simulation* sim, size_t idx) const noexcept;
     void snapshot(Simulation* sim, size_t idx, const snapshot_entry<Tag>& se) noexcept;
+    void checkpoint(archive& ar);   // complete state
     static std::vector<snapshot_entry<Tag>> init_pop(const Simulation& sim, const json& J);
 
     const int& get_current_state() const noexcept { return current_state_; }
@@ -128,7 +136,7 @@ namespace model {
     vec3 accel;  // [m/tick ^ 2]
     vec3 force;             // reserved for physical forces  [kg * m/tick^2]
     vec3 steering;    // linear, lateral  [kg * m/tick^2]
-    int target = -1;
+    int target = -1;        // external id of the target starling
     tick_t state_timer;    // to be copyied by neighbors
     int copy_state;    // to be copyied by neighbors
 
@@ -137,7 +145,7 @@ namespace model {
 
   private:
     int current_state_ = 0;
-    static transitions transitions_;
+    std::shared_ptr<const transitions> transitions_;   // shared by the agents of a simulation
     AP::package_array pa_;
   };
 
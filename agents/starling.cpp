@@ -8,7 +8,6 @@ namespace model {
     thread_local rndutils::mutable_discrete_distribution<int, rndutils::all_zero_policy_uni> starling_discrete_dist;
   }
 
-  decltype(Starling::transitions_) Starling::transitions_;
   
   template <typename Init>
   void do_init_pop(std::vector<snapshot_entry<starling_tag>>& vse, Init&& init)
@@ -33,7 +32,7 @@ namespace model {
   }
 
 
-  Starling::Starling(size_t idx, const json& J) :
+  Starling::Starling(size_t idx, const json& J, const Simulation& sim) :
     current_state_(0),
     copy_duration(0),
     copy_state(0),
@@ -42,11 +41,9 @@ namespace model {
     dir(1, 0, 0),
     accel(0) // [m / s^2]
   {
-    if (idx == 0) {
-      transitions_ = decltype(transitions_)(J);
-    }
+    transitions_ = (idx == 0) ? std::make_shared<const transitions>(J) : sim.pop<Tag>().front().transitions_;
     
-    pa_ = AP::create(idx, J["states"]);
+    pa_ = AP::create(idx, J["states"], sim);
     //auto stress_decay = J["stress"]["decay"]; // [stress/s]
     float stress_mean = J["stress"]["ind_var_mean"]; 
     float stress_sd = J["stress"]["ind_var_sd"]; 
@@ -56,7 +53,7 @@ namespace model {
         stress = stress_ofs_ = str_pdist(model::reng);
     }
     else { stress = stress_ofs_ = 0.f;  }
-    sp_ = stress_accum::create(idx, J["stress"]["sources"]);
+    sp_ = stress_accum::create(idx, J["stress"]["sources"], sim);
 
     ai = flight::create_aero_info<float>(J["aero"]);
     sa.w = 0.f; // until they get value from state (first integrates before update)
@@ -66,14 +63,14 @@ namespace model {
 
   void Starling::initialize(size_t idx, const Simulation& sim, const json& J)
   {
-    pa_[current_state_]->enter(this, idx, 0, sim);
+    pa_[current_state_]->enter(this, idx, sim.tick(), sim);
   }
 
   ::model::instance_proxy Starling::instance_proxy(long long color_map, size_t idx, const Simulation* sim) const noexcept
   {
     float tex = -1.f;
     switch (color_map) {
-    case 1: tex = float(idx) / sim->pop<Tag>().size(); break;
+    case 1: tex = float(sim->id_of<Tag>(idx)) / sim->pop<Tag>().size(); break;
     case 2: tex = glm::clamp(speed / ai.maxSpeed, 0.f, 1.f); break;
     case 3: {
       tex = 0.5f + flight_control::bank(this) / math::pi<float>; break;
@@ -100,6 +97,14 @@ namespace model {
 	  stress = se.stress;
   }
 
+  void Starling::checkpoint(archive& ar)
+  {
+    ar(pos, dir, speed, ang_vel, accel, reaction_time, last_update, stress, tm, force, steering);
+    ar(copy_duration, copy_state, state_timer, sa, current_state_, stress_ofs_);
+    if (ar.parameters()) ar(ai, sp_);
+    for (auto& s : pa_) s->checkpoint(ar);
+  }
+
   size_t Starling::update(size_t idx, tick_t T, const Simulation& sim)
   {
     steering = vec3(0); 
@@ -110,7 +115,7 @@ namespace model {
 
   void Starling::integrate(tick_t T, const Simulation& sim)
   {
-    flight_control::integrate_motion(this);    
+    flight_control::integrate_motion(this, sim.dt());    
     // stress -= stress * (stress_decay_ * Simulation::dt());
   }
 
@@ -120,12 +125,12 @@ namespace model {
     state_timer = tick_t(0); 
     stress = stress_ofs_;
     stress_accum::apply(sp_, this, idx, T, sim);
-    const auto TM = transitions_(stress);
+    const auto TM = (*transitions_)(stress);
     tm = TM[current_state_];
     starling_discrete_dist.mutate(TM[current_state_].cbegin(), TM[current_state_].cend());
     current_state_ = starling_discrete_dist(reng);
 
-    if (copy_duration > Simulation::dt())
+    if (copy_duration > sim.dt())
     {
         current_state_ = copy_state;
         pa_[current_state_]->check_state_entry(this, idx, T, sim);
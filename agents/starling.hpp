@@ -42,6 +42,13 @@ namespace model {
   };
 
 
+  template <>
+  struct neighbor_species<starling_tag>
+  {
+    using type = std::tuple<starling_tag, pred_tag>;   // flocking; predator avoidance & stress
+  };
+
+
   template <>
   struct snapshot_entry<starling_tag>
   {
@@ -83,20 +90,20 @@ namespace model {
     static constexpr const char* name() { return "Starling"; }
 
     using AP = states::package<
-      states::transient<actions::package<Starling, // normal flocking
+      states::transient<actions::fused_package<Starling, // normal flocking
         actions::align_n<Starling>,
 		    actions::cohere_centroid_distance<Starling>,
         actions::avoid_n_position<Starling>,
         actions::copy_escape<Starling>,
         actions::wiggle<Starling>
         >>, 
-        states::persistent<actions::package<Starling, // escape penalty
+        states::persistent<actions::fused_package<Starling, // escape penalty
             actions::wiggle<Starling>,
         actions::align_n<Starling>,
         actions::cohere_centroid_distance<Starling>,
         actions::avoid_n_position<Starling>
         >>,
-        states::persistent<actions::package<Starling, // escaoe twi
+        states::persistent<actions::fused_package<Starling, // escaoe twi
   	        actions::relative_roosting_persistant<Starling>, // switch to: random_t_turn_gamma_pred for unidirectional escape
             actions::align_n<Starling>,
             actions::cohere_centroid_distance<Starling>,
@@ -111,7 +118,7 @@ namespace model {
 
   public:
     Starling(Starling&&) = default;
-    Starling(size_t idx, const json& J);
+    Starling(size_t idx, const json& J, const Simulation& sim);
 
     void initialize(size_t idx, const Simulation& sim, const json& J);
 
@@ -123,6 +130,7 @@ namespace model {
     ::model::instance_proxy instance_proxy(long long color_map, size_t idx, const class Simulation* sim) const noexcept;
     ::model::snapshot_entry<Tag> snapshot(const Simulation* sim, size_t idx) const noexcept;
     void snapshot(Simulation* sim, size_t idx, const snapshot_entry<Tag>& se) noexcept;
+    void checkpoint(archive& ar);   // complete state
     static float distance2(const vec3& a, const vec3& b) { return glm::distance2(a, b); }
     static float bearing_angl(const vec3& d, const vec3& a, const vec3& b) { return math::rad_between_xy(d, space::ofs(a, b)); }
    
@@ -151,7 +159,7 @@ namespace model {
     static std::vector<snapshot_entry<Tag>> init_pop(const Simulation& sim, const json& J);
 
   private:
-    static transitions transitions_;
+    std::shared_ptr<const transitions> transitions_;   // shared by the agents of a simulation
     int current_state_ = 0;
     float stress_ofs_; // stress offset (individual variation)
     AP::package_array pa_;
@@ -51,14 +51,13 @@ namespace analysis
 
 		vec3 adir(0.f);
 		auto n = 0.f; // number of neighbors
-		sim.visit_all<starling_tag>([&](auto& p, size_t idx) {
-			if (idx != idxf) {
-				if (sim.flock_of<starling_tag>(idxf) == sim.flock_of<starling_tag>(idx)) {
-					adir += space::ofs(pf.pos, p.pos);
-					++n;
-				}	
+		const auto& pop = sim.pop<starling_tag>();
+		for (const auto idx : sim.flock_members<starling_tag>(sim.flock_of<starling_tag>(idxf))) {
+			if (idx != idxf && sim.is_active<starling_tag>(idx)) {
+				adir += space::ofs(pf.pos, pop[idx].pos);
+				++n;
 			}
-		});
+		}
 
 		if (n) {
 			return glm::length(adir / n);
@@ -102,12 +101,18 @@ namespace analysis
 		auto distr = std::uniform_int_distribution<int>(0, 1000);
 		const auto random_id = std::to_string(distr(model::reng));
 		const time_t now = time(0);
-		struct tm* local_time = localtime(&now);
+		struct tm local_time {};    // not localtime(), sweep runs get here concurrently
+#ifdef _WIN32
+		localtime_s(&local_time, &now);
+#else
+		localtime_r(&now, &local_time);
+#endif
 
-		const std::string thyear = std::to_string(1900 + local_time->tm_year);
-		const std::string thmonth = std::to_string(1 + local_time->tm_mon) + std::to_string(local_time->tm_mday);
-		const std::string thtime = std::to_string(local_time->tm_hour) + std::to_string(local_time->tm_min) + std::to_string(local_time->tm_sec);
-		const std::string full_name = thyear + thmonth + thtime + std::to_string(now) + random_id;
+		const std::string thyear = std::to_string(1900 + local_time.tm_year);
+		const std::string thmonth = std::to_string(1 + local_time.tm_mon) + std::to_string(local_time.tm_mday);
+		const std::string thtime = std::to_string(local_time.tm_hour) + std::to_string(local_time.tm_min) + std::to_string(local_time.tm_sec);
+		std::string full_name = thyear + thmonth + thtime + std::to_string(now) + random_id;
+		if (J.contains("run_id")) full_name += "_" + J["run_id"].get<std::string>();   // sweep runs
 
 		const auto outf = output_path(J);
 		const path_t filefolder = (outf / full_name).string();
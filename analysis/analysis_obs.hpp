@@ -12,10 +12,10 @@ namespace analysis
 	class TimeSeriesObserver : public model::AnalysisObserver
 	{
 	public:
-		TimeSeriesObserver(const std::filesystem::path& out_path, const json& J)
-			: AnalysisObserver(out_path, J)
+		TimeSeriesObserver(const std::filesystem::path& out_path, const json& J, float dt)
+			: AnalysisObserver(out_path, J, dt)
 		{
-			analysis::open_csv(outfile_stream_, full_out_path_, header_);
+			open_output(header_);
 		}
 		~TimeSeriesObserver() override {}
 
@@ -23,21 +23,21 @@ namespace analysis
 	protected:
 		void notify_collect(const model::Simulation& sim) override
 		{
-			const auto tt = static_cast<float>(sim.tick()) * model::Simulation::dt();
+			const auto tt = static_cast<float>(sim.tick()) * sim.dt();
 
-			sim.visit_all<Tag>([&](auto& p, size_t idx) {
+			sim.visit_active<Tag>([&](auto& p, size_t idx) {
 				// csv writing backwards, so vectors backwards from header, new element to be added in front
 				//const auto& fi = sim.flocks<Tag>();										// all flocks
 				const auto fl_id = sim.flock_of<Tag>(idx);
-				const auto& thisflock = sim.flocks<Tag>()[fl_id];
-				const auto dist2cent = glm::distance(p.pos, thisflock.gc()); // distance to center of flock
-				const auto dir2fcent = glm::normalize(space::ofs(p.pos, thisflock.gc()));
+				const auto gc = sim.flock_shape<Tag>(fl_id).gc();
+				const auto dist2cent = glm::distance(p.pos, gc); // distance to center of flock
+				const auto dir2fcent = glm::normalize(space::ofs(p.pos, gc));
 				//const auto head_dev = glm::degrees(math::rad_between(p.dir, thisflock.vel));		 // deviation of self heading to flocks heading
 				//const auto centr = centrality(p, idx, sim);
 				//const auto rad2fcent = math::rad_between(p.dir, dir2fcent);
 
 				//const auto nn = sim.sorted_view<Tag>(idx).cbegin(); // nearest neighbor
-				data_out_.push_back({ dir2fcent.y, dir2fcent.x, dist2cent, static_cast<float>(p.get_current_state()), p.ang_vel, p.accel.y, p.accel.x, p.speed, p.dir.y,  p.dir.x,  p.pos.y, p.pos.x, static_cast<float>(idx), tt });
+				data_out_.push_back({ dir2fcent.y, dir2fcent.x, dist2cent, static_cast<float>(p.get_current_state()), p.ang_vel, p.accel.y, p.accel.x, p.speed, p.dir.y,  p.dir.x,  p.pos.y, p.pos.x, static_cast<float>(sim.id_of<Tag>(idx)), tt });
 			});
 		}
 
@@ -52,6 +52,97 @@ namespace analysis
 		const std::string header_ = "time,id,posx,posy,dirx,diry,speed,accelx,accely,ang_vel,state,dist2fcent,dirX2fcent,dirY2fcent";
 	};
 
+
+	// flock births, deaths, splits and merges as they happen (model::flock_event).
+	// event: 0 birth, 1 death, 2 split, 3 merge; other: -1 if none.
+	// written as integers, ticks and ids outgrow float precision in long runs.
+	template <typename Tag>
+	class FlockEventObserver : public model::AnalysisObserver
+	{
+	public:
+		FlockEventObserver(const std::filesystem::path& out_path, const json& J, float dt)
+			: AnalysisObserver(out_path, J, dt)
+		{
+			open_output(header_);
+		}
+		~FlockEventObserver() override {}
+
+	protected:
+		void notify_tick(const model::Simulation& sim) override
+		{
+			const auto& events = sim.flock_events<Tag>();
+			if (events.empty() || events.front().tick == last_tick_) return;
+			last_tick_ = events.front().tick;
+			events_.insert(events_.end(), events.cbegin(), events.cend());
+			if (events_.size() > 10000) notify_save(sim);    // avoid overflow
+		}
+
+		void notify_save(const model::Simulation& sim) override
+		{
+			for (const auto& e : events_) {
+				const auto other = (e.other == model::no_flock) ? -1ll : static_cast<long long>(e.other);
+				outfile_stream_ << e.tick << ',' << static_cast<unsigned>(e.type) << ',' << e.flock << ',' << other << ',' << e.size << '\n';
+			}
+			outfile_stream_.flush();
+			events_.clear();
+		}
+
+	private:
+		tick_t last_tick_ = static_cast<tick_t>(-1);
+		std::vector<model::flock_event> events_;
+		const std::string header_ = "tick,event,flock,other,size";
+	};
+
+
+	// dendrogram of the single-linkage flocks (model::flock_hierarchy) as its
+	// spanning forest after every clustering pass: one row per edge, ids of
+	// the joined agents and the distance they join at. cutting the edges
+	// >= t leaves the flocks at t.
+	template <typename Tag>
+	class FlockHierarchyObserver : public model::AnalysisObserver
+	{
+	public:
+		FlockHierarchyObserver(const std::filesystem::path& out_path, const json& J, float dt)
+			: AnalysisObserver(out_path, J, dt)
+		{
+			open_output(header_);
+		}
+		~FlockHierarchyObserver() override {}
+
+	protected:
+		void notify_tick(const model::Simulation& sim) override
+		{
+			const auto& h = sim.flock_levels<Tag>();
+			if (!h.enabled() || h.forest().empty() || h.tick() == last_tick_) return;
+			last_tick_ = h.tick();
+			for (const auto& e : h.forest()) {
+				rows_.push_back({ h.tick(), static_cast<unsigned>(sim.id_of<Tag>(e.a)), static_cast<unsigned>(sim.id_of<Tag>(e.b)), std::sqrt(e.d2) });
+			}
+			if (rows_.size() > 10000) notify_save(sim);    // avoid overflow
+		}
+
+		void notify_save(const model::Simulation& sim) override
+		{
+			for (const auto& r : rows_) {
+				outfile_stream_ << r.tick << ',' << r.a << ',' << r.b << ',' << r.dist << '\n';
+			}
+			outfile_stream_.flush();
+			rows_.clear();
+		}
+
+	private:
+		struct row
+		{
+			tick_t tick;
+			unsigned a, b;    // ids
+			float dist;
+		};
+
+		tick_t last_tick_ = static_cast<tick_t>(-1);
+		std::vector<row> rows_;
+		const std::string header_ = "tick,a,b,dist";
+	};
+
 }
 
 #endif
@@ -4,6 +4,7 @@
 
 #include <memory>
 #include <future>
+#include <iterator>
 #include <deque>
 #include <set>
 #include <algorithm>
@@ -23,6 +24,11 @@ namespace analysis {
       model::vec3 pos;
       model::vec3 dir;
       std::vector<model::neighbor_info> ninfo;
+
+      void checkpoint(model::archive& ar)
+      {
+        ar(pos, dir, ninfo);
+      }
     };
 
     using snapshot_t = std::vector<snapshot_data>;
@@ -156,11 +162,12 @@ template <typename Tag>
   class DiffusionObserver : public model::AnalysisObserver 
   {
   public:
-    DiffusionObserver(const std::filesystem::path& out_path, const json& J) :
-      AnalysisObserver(out_path, J),
+    DiffusionObserver(const std::filesystem::path& out_path, const json& J, float dt) :
+      AnalysisObserver(out_path, J, dt),
       max_Qm_topo_(J["max_Qm_topo"]),
       max_D_topo_(J["max_D_topo"]),
-      wsize_(model::Simulation::time2tick(double(J["window"]) / this->oi_.sample_freq))
+      dt_(dt),
+      wsize_(static_cast<size_t>(double(J["window"]) / this->oi_.sample_freq / dt))
     {}
 
     ~DiffusionObserver()
@@ -207,6 +214,15 @@ template <typename Tag>
       fdp.get();
     }
 
+    // the window and the timeseries so far, the files are rewritten on save
+    void checkpoint_output(model::archive& ar) override
+    {
+      if (future_.valid()) future_.get();
+      auto window = std::vector<diffusion::snapshot_t>(std::make_move_iterator(window_.begin()), std::make_move_iterator(window_.end()));
+      ar(window, Qmt_, R_, Dfor_, Dequ_);
+      window_.assign(std::make_move_iterator(window.begin()), std::make_move_iterator(window.end()));
+    }
+
     void pull_data(const model::Simulation& sim)
     {
       const auto& pop = sim.pop<Tag>();
@@ -220,14 +236,16 @@ template <typename Tag>
         auto state = diffusion::snapshot_t(sim.pop<Tag>().size(), { {}, {}, std::vector<model::neighbor_info>(max_topo_) });
         window_.emplace_back(std::move(state));
       }
+      // by external id, agents might be reordered within the window
       auto& state = window_.back();
       for (size_t i = 0; i < pop.size(); ++i) {
-        auto& pivot = state[i];
+        auto& pivot = state[sim.id_of<Tag>(i)];
         pivot.pos = pop[i].pos;
         pivot.dir = pop[i].dir;
         auto sv = sim.sorted_view<Tag>(i);
         const auto n = std::min(sv.size(), max_topo_);
         pivot.ninfo.assign(sv.cbegin(), sv.cbegin() + n);
+        for (auto& ni : pivot.ninfo) ni.idx = static_cast<unsigned>(sim.id_of<Tag>(ni.idx));
         std::fill(pivot.ninfo.begin() + n, pivot.ninfo.end(), model::neighbor_info{});
       }
     }
@@ -249,7 +267,7 @@ template <typename Tag>
       auto fn = fp / "Qm.csv";
       auto os = std::ofstream(fn);
       for (size_t i = 0; i < Qmt_.size(); ++i) {
-        os << oi_.sample_freq * model::Simulation::tick2time(model::tick_t{ i });
+        os << oi_.sample_freq * (dt_ * i);
         for (const auto& x : Qmt_[i]) {
           os << ',' << x;
         }
@@ -264,7 +282,7 @@ template <typename Tag>
       auto fn = fp / "R.csv";
       auto os = std::ofstream(fn);
       for (size_t i = 0; i < R_.size(); ++i) {
-        os << oi_.sample_freq * model::Simulation::tick2time(model::tick_t{ i });
+        os << oi_.sample_freq * (dt_ * i);
         for (const auto& x : R_[i]) {
           os << ',' << x;
         }
@@ -280,7 +298,7 @@ template <typename Tag>
         auto fn = fp / (prefix + std::to_string(topo) + ".csv");
         auto os = std::ofstream(fn);
         for (size_t i = 0; i < D[topo].size(); ++i) {
-          os << oi_.sample_freq * model::Simulation::tick2time(model::tick_t{ i });
+          os << oi_.sample_freq * (dt_ * i);
           for (const auto& x : D[topo][i]) {
             os << ',' << x;
           }
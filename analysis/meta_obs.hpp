@@ -38,9 +38,9 @@ namespace analysis
 
 		void notify_collect(const model::Simulation& sim)
 		{
-			sim.visit_all<Tag>([&](auto& p, size_t idx) {
+			sim.visit_active<Tag>([&](auto& p, size_t idx) {
 				// csv writing backwards, so vectors backwards from header, new element to be added in front
-   			data_out_.push_back({ p.accel.y, p.accel.x, p.speed, p.dir.y,  p.dir.x,  p.pos.y, p.pos.x, static_cast<float>(idx) });
+   			data_out_.push_back({ p.accel.y, p.accel.x, p.speed, p.dir.y,  p.dir.x,  p.pos.y, p.pos.x, static_cast<float>(sim.id_of<Tag>(idx)) });
   		});
 		}
 
@@ -75,6 +75,7 @@ namespace analysis
 			auto& ja = J["Simulation"]["Analysis"];
 
 			const std::string outf = ja["output_path"];
+			output_path_ = outf;
 
 			json_ext_ = ja["Externals"];
 			json_ext_["output_path"] = outf;
@@ -108,6 +109,7 @@ namespace analysis
 
 		void notify_save(const model::Simulation& sim)
 		{
+			std::ofstream(output_path_ / "stop_reason.txt") << sim.stop_reason() << '\t' << sim.time() << '\n';
 			if (int(json_ext_["plot?"]) != 0)
 			{
 				analysis::plot_data_bash(json_ext_);
@@ -116,6 +118,7 @@ namespace analysis
 
 	private:
 		json json_ext_;
+		path_t output_path_;
 	};
 
 
@@ -132,18 +135,22 @@ namespace analysis
 			std::cout << "No analysis observers created, data extraction will not take place." << std::endl;
 			return res; // no observers created
 		}
-		const auto unique_path = analysis::unique_output_folder(ja);
+		// resume_path: output folder of the interrupted run
+		const auto unique_path = ja.contains("resume_path") ? path_t(ja["resume_path"].get<std::string>()) : analysis::unique_output_folder(ja);
 
 		// inject output path to json object
 		ja["output_path"] = unique_path.string();
 
+		const float dt = J["Simulation"]["dt"];
 		const auto& jo = ja["Observers"];
 		for (const auto& j : jo)
 		{
 			std::string type = j["type"];
-			if (type == "TimeSeries") res.emplace_back(std::make_unique<TimeSeriesObserver<Tag>>(unique_path, j));
+			if (type == "TimeSeries") res.emplace_back(std::make_unique<TimeSeriesObserver<Tag>>(unique_path, j, dt));
 			else if (type == "SnapShot") res.emplace_back(std::make_unique<SnapShotObserver<Tag>>(unique_path, j));
-			else if (type == "Diffusion") res.emplace_back(std::make_unique<DiffusionObserver<Tag>>(unique_path, j));
+			else if (type == "Diffusion") res.emplace_back(std::make_unique<DiffusionObserver<Tag>>(unique_path, j, dt));
+			else if (type == "FlockEvents") res.emplace_back(std::make_unique<FlockEventObserver<Tag>>(unique_path, j, dt));
+			else if (type == "FlockHierarchy") res.emplace_back(std::make_unique<FlockHierarchyObserver<Tag>>(unique_path, j, dt));
 			else throw std::runtime_error("unknown observer");
 		}
 		res.emplace_back(std::make_unique<DataExpObserver>(J)); // has to be at the end of the chain
@@ -0,0 +1,110 @@
+// Microbenchmark: neighbor row construction, per pair loop vs. row kernels.
+//
+//   row_kernel_bench [n=4096] [rounds=2000]
+//
+// 'loop' is the former per pair code: glm::distance2, math::rad_between_xy
+// (std::atan2) and std::find over the escape states.
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+#include <libs/math.hpp>
+#include <libs/space.hpp>
+#include <model/row_kernel.hpp>
+
+
+using namespace model;
+
+
+struct pair_info
+{
+  float dist2;
+  float bangl;
+  bool is_esc;
+};
+
+
+template <typename Fun>
+double time_it(int rounds, Fun&& fun)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; ++r) fun(r);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+int main(int argc, const char* argv[])
+{
+  const size_t n = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4096;
+  const int rounds = (argc > 2) ? std::atoi(argv[2]) : 2000;
+  std::mt19937 reng(42);
+  std::uniform_real_distribution<float> upos(-200.f, 200.f);
+  std::uniform_int_distribution<int> ustate(0, 2);
+  std::vector<glm::vec3> pos(n), dir(n);
+  std::vector<float> x(n), y(n), z(n);
+  std::vector<int> state(n);
+  for (size_t i = 0; i < n; ++i) {
+    pos[i] = glm::vec3(upos(reng), upos(reng), 0.1f * upos(reng));
+    dir[i] = glm::normalize(glm::vec3(upos(reng), upos(reng), 0.f));
+    x[i] = pos[i].x; y[i] = pos[i].y; z[i] = pos[i].z;
+    state[i] = ustate(reng);
+  }
+  std::vector<unsigned> idx(n);
+  for (unsigned i = 0; i < n; ++i) idx[i] = i;
+  std::shuffle(idx.begin(), idx.end(), reng);
+  const std::vector<int> esc_states = { 2 };
+  const std::uint64_t esc_mask = std::uint64_t(1) << 2;
+
+  std::vector<pair_info> out(n);
+  std::vector<float> dd(n), ba(n);
+  float sink = 0.f;
+
+  const auto t_loop = time_it(rounds, [&](int r) {
+    const auto i = idx[r % n];
+    for (size_t k = 0; k < n; ++k) {
+      const auto j = idx[k];
+      out[k] = { glm::distance2(pos[i], pos[j]),
+                 math::rad_between_xy(dir[i], space::ofs(pos[i], pos[j])),
+                 std::find(esc_states.begin(), esc_states.end(), state[j]) != esc_states.end() };
+    }
+    sink += out[r % n].bangl;
+  });
+  std::printf("n = %zu, %d rounds, host: %s\n", n, rounds, row_kernel::name(row_kernel::host_isa()));
+  std::printf("%-12s %6.2f ns/pair\n", "loop", 1e9 * t_loop / (double(n) * rounds));
+
+  for (const auto isa : { row_kernel::Isa::Scalar, row_kernel::Isa::AVX2, row_kernel::Isa::AVX512 }) {
+    if (isa > row_kernel::host_isa()) continue;
+    const auto kernel = row_kernel::select(isa);
+    for (const bool gather : { false, true }) {
+      const auto t = time_it(rounds, [&](int r) {
+        const auto i = idx[r % n];
+        const auto q = row_kernel::query{ { x[i], y[i], z[i] }, { dir[i].x, dir[i].y, dir[i].z }, x.data(), y.data(), z.data(), gather ? idx.data() : nullptr, n };
+        kernel(q, dd.data(), ba.data());
+        for (size_t k = 0; k < n; ++k) {
+          const auto j = gather ? idx[k] : k;
+          out[k] = { dd[k], ba[k], ((esc_mask >> state[j]) & 1) != 0 };
+        }
+        sink += out[r % n].bangl;
+      });
+      // accuracy against the loop
+      double max_err = 0.0;
+      const auto i = idx[0];
+      const auto q = row_kernel::query{ { x[i], y[i], z[i] }, { dir[i].x, dir[i].y, dir[i].z }, x.data(), y.data(), z.data(), idx.data(), n };
+      kernel(q, dd.data(), ba.data());
+      for (size_t k = 0; k < n; ++k) {
+        const auto j = idx[k];
+        if (j == i) continue;
+        max_err = std::max(max_err, double(std::abs(ba[k] - math::rad_between_xy(dir[i], space::ofs(pos[i], pos[j])))));
+      }
+      const auto label = std::string(row_kernel::name(isa)) + (gather ? "/idx" : "");
+      std::printf("%-12s %6.2f ns/pair  speedup %5.1f  max bearing error %.1e rad\n", label.c_str(), 1e9 * t / (double(n) * rounds), t_loop / t, max_err);
+    }
+  }
+  return sink == 12345.f;
+}
@@ -1,7 +1,9 @@
 #ifndef MODEL_ACTIONS_ACTION_BASE_HPP_INCLUDED
 #define MODEL_ACTIONS_ACTION_BASE_HPP_INCLUDED
 
+#include <algorithm>
 #include <model/simulation.hpp>
+#include <libs/space.hpp>
 
 
 namespace model {
@@ -15,27 +17,110 @@ namespace model {
     *    public:
     *      using agent_type = Agent;
     *      action() = default;
-    *      action(size_t idx, const json& J);
+    *      action(size_t idx, const json& J);              // or (idx, J, const Simulation&)
     *      void operator(agent_type* self, size_t idx, tick_t T, const Simulation& sim);
     *      void on_entry(agent_type* self, size_t idx, tick_t T, const Simulation& sim);
     *    };
     *
+    *  actions that walk the same-species neighborhood may be written as
+    *  accumulators over neighbor_walk() instead (see align_n):
+    *
+    *      bool begin(agent_type* self);                                    // false: no neighbors needed
+    *      bool visit(agent_type* self, const neighbor_ctx<agent_type>& nc); // false: saturated
+    *      void end(agent_type* self);                                      // apply result
+    *
+    *  within a fused_package they share a single traversal.
+    *
+    *  actions that keep run state beyond a single update (e.g. set on_entry)
+    *  declare it for branch points (see archive):
+    *
+    *      void run_state(archive& ar);
     */
 
+
+    // per neighbor quantities shared by the actions of a neighbor walk
+    template <typename Agent>
+    struct neighbor_ctx
+    {
+      const neighbor_info& ni;
+      const Simulation& sim;
+      const Agent& other;     // the neighbor, cold state
+      vec3 pos;        // of the neighbor, see Simulation::kin()
+      vec3 dir;
+      vec3 offs;       // self -> neighbor
+      float dist;      // sqrt(ni.dist2)
+      float dot;       // dot(self->dir, offs)
+
+      // see in_fov()
+      template <typename Action>
+      bool in_fov(const Action& act) const noexcept
+      {
+        return ni.dist2 != 0.0f && ni.dist2 < act.maxdist2 && dot > dist * act.cfov;
+      }
+    };
+
+
+    // archives an action tuple: complete if ar.parameters(),
+    // otherwise the run_state() of the actions that have one.
+    template <typename... Actions>
+    inline void checkpoint_actions(archive& ar, std::tuple<Actions...>& actions)
+    {
+      std::apply([&ar](auto& ... act) {
+        ([&ar](auto& a) {
+          if (ar.parameters()) ar(a);
+          else if constexpr (requires { a.run_state(ar); }) a.run_state(ar);
+        }(act), ...);
+      }, actions);
+    }
+
+
+    template <typename Action>
+    inline constexpr bool is_fusable = requires (Action& a, typename Action::agent_type* self, const neighbor_ctx<typename Action::agent_type>& nc) {
+      a.maxdist2;
+      a.begin(self);
+      a.visit(self, nc);
+      a.end(self);
+    };
+
+
+    // walks the same-species neighborhood of self once and feeds every
+    // neighbor to the actions until all of them are saturated.
+    template <typename Agent, typename ... Actions>
+    inline void neighbor_walk(Agent* self, size_t idx, const Simulation& sim, Actions& ... acts)
+    {
+      using Tag = typename Agent::Tag;
+      static_assert(sizeof...(Actions) <= 32);
+      unsigned busy = 0, bit = 1;
+      ((busy |= acts.begin(self) ? bit : 0, bit <<= 1), ...);
+      const auto sv = sim.sorted_view<Tag>(idx);
+      const auto& kin = sim.kin<Tag>();
+      const auto& pop = sim.pop<Tag>();
+      // the row is sorted by distance: nobody sees beyond the widest range
+      const auto reach2 = std::max({ acts.maxdist2... });
+      for (auto it = sv.cbegin(); busy && (it != sv.cend()) && (it->dist2 < reach2); ++it) {
+        const auto pos = kin.pos(it->idx);
+        const auto offs = space::ofs(self->pos, pos);
+        const neighbor_ctx<Agent> nc{ *it, sim, pop[it->idx], pos, kin.dir(it->idx), offs, glm::sqrt(it->dist2), glm::dot(self->dir, offs) };
+        bit = 1;
+        ((busy &= ((busy & bit) && !acts.visit(self, nc)) ? ~bit : ~0u, bit <<= 1), ...);
+      }
+    }
+
     template <typename Agent, typename ... Actions>
     class package
     {
     public:
       static constexpr size_t size = sizeof...(Actions);
+      static constexpr bool fused = false;
       using package_tuple = std::tuple<Actions...>;
       using agent_type = Agent;
 
-      static package_tuple create(size_t idx, const json& J)
+      static package_tuple create(size_t idx, const json& J, const Simulation& sim)
       {
         package_tuple t;
         //assert(J.size() == size);
         if (J.size() != size) throw std::runtime_error("Parsing error: Number of actions differs in code and config  \n");
-        do_create<0>::apply(t, idx, J);
+        do_create<0>::apply(t, idx, J, sim);
         return t;
       }
 
@@ -44,13 +129,15 @@ namespace model {
       struct do_create
       {
         template <typename Json>
-        static void apply(package_tuple& t, size_t idx, const Json& J)
+        static void apply(package_tuple& t, size_t idx, const Json& J, const Simulation& sim)
         {
           using type = std::tuple_element_t<I, package_tuple>;
           //assert(J[I]["name"] == type::name());
           if (J[I]["name"] != type::name()) throw std::runtime_error("Parsing error: Name of action differs in code (" + std::string(type::name()) + ") and config (" + std::string(J[I]["name"]) + ")  \n");
-          std::get<I>(t) = type(idx, J[I]);
-          do_create<I + 1>::apply(t, idx, J);
+          // actions that depend on the simulation settings (dt) take them as 3rd argument
+          if constexpr (std::is_constructible_v<type, size_t, const Json&, const Simulation&>) std::get<I>(t) = type(idx, J[I], sim);
+          else std::get<I>(t) = type(idx, J[I]);
+          do_create<I + 1>::apply(t, idx, J, sim);
         }
       };
 
@@ -58,10 +145,43 @@ namespace model {
       struct do_create<size>
       {
         template <typename J>
-        static void apply(package_tuple&, size_t, const J&) {}
+        static void apply(package_tuple&, size_t, const J&, const Simulation&) {}
       };
     };
 
+
+    // package whose fusable actions share one neighbor walk per update.
+    // the walk precedes the chain, the results are applied in chain order.
+    template <typename Agent, typename ... Actions>
+    class fused_package : public package<Agent, Actions...>
+    {
+    public:
+      using typename package<Agent, Actions...>::package_tuple;
+      static constexpr bool fused = true;
+
+      static void walk(package_tuple& t, Agent* self, size_t idx, const Simulation& sim)
+      {
+        walk_(t, self, idx, sim, std::make_index_sequence<sizeof...(Actions)>{});
+      }
+
+    private:
+      template <size_t I>
+      static auto fusable_ref(package_tuple& t)
+      {
+        using type = std::tuple_element_t<I, package_tuple>;
+        if constexpr (is_fusable<type>) return std::tuple<type&>(std::get<I>(t));
+        else return std::tuple<>{};
+      }
+
+      template <size_t... I>
+      static void walk_(package_tuple& t, Agent* self, size_t idx, const Simulation& sim, std::index_sequence<I...>)
+      {
+        std::apply([&](auto& ... acts) {
+          if constexpr (sizeof...(acts) > 0) neighbor_walk(self, idx, sim, acts...);
+        }, std::tuple_cat(fusable_ref<I>(t)...));
+      }
+    };
+
   }
 }
 
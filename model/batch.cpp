@@ -0,0 +1,55 @@
+#include <future>
+#include <tbb/tbb.h>
+#include <model/batch.hpp>
+#include <model/observer.hpp>
+
+
+namespace model {
+
+  void run_job(batch_job& job)
+  {
+    auto* sim = job.sim;
+    std::future<void> writer;
+    bool initialized = false;
+    try {
+      if (job.resume && std::filesystem::exists(job.checkpoint)) {
+        sim->restore(read_checkpoint(job.checkpoint), job.observer);
+      }
+      else if (job.branch_point) {
+        sim->restore(*job.branch_point);
+      }
+      else {
+        sim->set_snapshots(job.snapshots);
+      }
+      initialized = true;
+      if (job.observer) job.observer->notify(Simulation::Initialized, *sim);
+      job.stop.start(*sim);
+      const char* reason = nullptr;
+      while (!reason && !sim->terminated() && sim->tick() < job.tmax) {
+        tbb::this_task_arena::isolate([&] { sim->update(job.observer); });
+        if (job.checkpoint_interval && (sim->tick() % job.checkpoint_interval == 0)) {
+          if (writer.valid()) writer.get();
+          writer = std::async(std::launch::async, [file = job.checkpoint, buf = sim->checkpoint(job.observer)]() { write_checkpoint(file, buf); });
+        }
+        reason = job.stop(*sim);
+      }
+      sim->set_stop_reason(reason ? reason : (sim->terminated() ? "terminated" : "Tmax"));
+      if (writer.valid()) writer.get();
+    }
+    catch (...) {
+      job.error = std::current_exception();
+      sim->set_stop_reason("error");
+    }
+    if (initialized && job.observer) job.observer->notify(Simulation::Finished, *sim);
+  }
+
+
+  void run_batch(std::vector<batch_job>& jobs, int num_threads)
+  {
+    auto arena = tbb::task_arena(num_threads > 0 ? num_threads : tbb::task_arena::automatic);
+    arena.execute([&] {
+      tbb::parallel_for_each(jobs.begin(), jobs.end(), [](batch_job& job) { run_job(job); });
+    });
+  }
+
+}
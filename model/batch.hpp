@@ -0,0 +1,49 @@
+#ifndef MODEL_BATCH_HPP_INCLUDED
+#define MODEL_BATCH_HPP_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <exception>
+#include <filesystem>
+#include <agents/agents.hpp>
+#include <model/simulation.hpp>
+#include <model/stop_criteria.hpp>
+
+
+namespace model {
+
+
+  // one simulation of a batch
+  struct batch_job
+  {
+    Simulation* sim = nullptr;
+    class Observer* observer = nullptr;   // observer chain, might be nullptr
+    tick_t tmax = 0;                      // [tick]
+    species_snapshots snapshots = {};     // passed to Simulation::initialize
+    std::exception_ptr error = nullptr;   // set if the run has thrown
+    std::filesystem::path checkpoint = {};  // checkpoint file, see Simulation::checkpoint
+    tick_t checkpoint_interval = 0;       // [tick] 0: no checkpoints
+    bool resume = false;                  // continue from the checkpoint file if it exists
+    std::shared_ptr<const std::vector<char>> branch_point = nullptr;   // start from, see Simulation::branch_point
+    stop_criteria stop = {};              // early termination
+  };
+
+
+  // runs a single job on the calling thread, within the current task arena:
+  // initializes (or restores) and updates the simulation until tmax,
+  // Simulation::terminate() or a stop criterion holds, see Simulation::stop_reason.
+  // the observer gets Finished if it got Initialized.
+  // checkpoints are written in the background, one at a time; they hold
+  // the observer chain's state, which writes out its buffers first.
+  void run_job(batch_job& job);
+
+
+  // runs the jobs side by side in one task arena of num_threads threads
+  // (< 1: all cores), see run_job.
+  // threads without a job of their own help within the running simulations,
+  // a thread waiting within one simulation never takes up another one.
+  void run_batch(std::vector<batch_job>& jobs, int num_threads);
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef MODEL_CHECKPOINT_HPP_INCLUDED
+#define MODEL_CHECKPOINT_HPP_INCLUDED
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+#include <type_traits>
+
+
+namespace model {
+
+
+  // binary archive of the checkpoint format, one for both directions:
+  // ar(x, y, ...) appends to the buffer if saving, reads from it if loading.
+  // trivially copyable types are copied as bytes, vectors, arrays and tuples
+  // element wise, everything else through its member checkpoint(archive&).
+  // the format is the memory layout of the build, not portable.
+  // without parameters() the archive holds the run state only (branch point),
+  // the parameters come from the configuration of the receiving simulation.
+  class archive
+  {
+  public:
+    static constexpr std::uint32_t version = 10;
+
+    // saving
+    explicit archive(bool parameters) : parameters_(parameters)
+    {
+      auto m = magic;
+      auto v = version;
+      (*this)(m, v, parameters_);
+    }
+
+    // loading, buf must outlive the archive
+    explicit archive(const std::vector<char>& buf) : in_(&buf)
+    {
+      auto m = magic;
+      auto v = version;
+      (*this)(m, v, parameters_);
+      if (m != magic) throw std::runtime_error("checkpoint: unknown format");
+      if (v != version) throw std::runtime_error("checkpoint: version mismatch");
+    }
+
+    bool loading() const noexcept { return in_ != nullptr; }
+    bool parameters() const noexcept { return parameters_; }
+    std::vector<char> release() noexcept { return std::move(buf_); }
+
+    template <typename... T>
+    void operator()(T&... x)
+    {
+      (io(x), ...);
+    }
+
+    // checks a value that must match on load
+    template <typename T>
+    void expect(T x, const char* what)
+    {
+      auto y = x;
+      io(y);
+      if (y != x) throw std::runtime_error(std::string("checkpoint: ") + what + " mismatch");
+    }
+
+  private:
+    template <typename T> struct is_vector : std::false_type {};
+    template <typename T, typename A> struct is_vector<std::vector<T, A>> : std::true_type {};
+    template <typename T> struct is_array : std::false_type {};
+    template <typename T, size_t N> struct is_array<std::array<T, N>> : std::true_type {};
+    template <typename T> struct is_tuple : std::false_type {};
+    template <typename... T> struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+    template <typename T>
+    void io(T& x)
+    {
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        bytes(&x, sizeof(T));
+      }
+      else if constexpr (is_vector<T>::value) {
+        auto n = static_cast<std::uint64_t>(x.size());
+        bytes(&n, sizeof(n));
+        if (loading()) x.resize(static_cast<size_t>(n));
+        if constexpr (std::is_trivially_copyable_v<typename T::value_type>) bytes(x.data(), x.size() * sizeof(typename T::value_type));
+        else for (auto& e : x) io(e);
+      }
+      else if constexpr (is_array<T>::value) {
+        for (auto& e : x) io(e);
+      }
+      else if constexpr (is_tuple<T>::value) {
+        std::apply([this](auto&... e) { (io(e), ...); }, x);
+      }
+      else {
+        x.checkpoint(*this);
+      }
+    }
+
+    void bytes(void* p, size_t n)
+    {
+      if (in_) {
+        if (pos_ + n > in_->size()) throw std::runtime_error("checkpoint: truncated");
+        std::memcpy(p, in_->data() + pos_, n);
+        pos_ += n;
+      }
+      else {
+        const auto* c = static_cast<const char*>(p);
+        buf_.insert(buf_.end(), c, c + n);
+      }
+    }
+
+    static constexpr std::array<char, 8> magic = { 'C', 'o', 'l', 'T', 'c', 'k', 'p', 't' };
+
+    const std::vector<char>* in_ = nullptr;
+    std::vector<char> buf_;
+    size_t pos_ = 0;
+    bool parameters_ = true;
+  };
+
+
+  // writes buf to file, atomically replacing an existing one
+  inline void write_checkpoint(const std::filesystem::path& file, const std::vector<char>& buf)
+  {
+    auto tmp = file;
+    tmp += ".tmp";
+    {
+      std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+      os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+      if (!os) throw std::runtime_error("checkpoint: can't write " + tmp.string());
+    }
+    std::filesystem::rename(tmp, file);
+  }
+
+
+  inline std::vector<char> read_checkpoint(const std::filesystem::path& file)
+  {
+    std::ifstream is(file, std::ios::binary);
+    if (!is) throw std::runtime_error("checkpoint: can't open " + file.string());
+    return std::vector<char>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+  }
+
+}
+
+#endif
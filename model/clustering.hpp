@@ -0,0 +1,156 @@
+#ifndef MODEL_CLUSTERING_HPP_INCLUDED
+#define MODEL_CLUSTERING_HPP_INCLUDED
+
+#include <cmath>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <tbb/tbb.h>
+#include <model/model.hpp>
+
+
+// building blocks of the single-linkage clustering, see flock_tracker
+// and flock_hierarchy
+namespace model {
+
+
+  // cell list over the points k = 0, 1, ... n - 1 in the xy-plane.
+  // with cell size >= radius the 3 x 3 cells around a point hold all points
+  // within that radius.
+  class cluster_grid
+  {
+  public:
+    // pos(k): position of point k
+    template <typename Pos>
+    void build(unsigned n, float cell_size, Pos&& pos)
+    {
+      inv_cell_ = 1.f / (1.0001f * cell_size);    // margin for the rounding of pos * inv_cell_
+      cells_.resize(n);
+      tbb::parallel_for(tbb::blocked_range<unsigned>(0, n), [&](const auto& r) {
+        for (auto k = r.begin(); k < r.end(); ++k) {
+          const auto p = pos(k);
+          cells_[k] = { cell_coor(p.x), cell_coor(p.y), k };
+        }
+      });
+      tbb::parallel_sort(cells_.begin(), cells_.end());
+    }
+
+    int cell_coor(float x) const noexcept
+    {
+      return static_cast<int>(std::floor(x * inv_cell_));
+    }
+
+    // calls fun(k) for all points k in the 3 x 3 cells around pos
+    template <typename Fun>
+    void visit_cells(const vec3& pos, Fun&& fun) const
+    {
+      const int cx = cell_coor(pos.x);
+      const int cy = cell_coor(pos.y);
+      for (int x = cx - 1; x <= cx + 1; ++x) visit_column(x, cy - 1, cy + 1, fun);
+    }
+
+    // calls fun(k) for all points k in the cells at Chebyshev distance r from (cx, cy).
+    // they are at least (r - 1) cell sizes away from any point in (cx, cy).
+    template <typename Fun>
+    void visit_ring(int cx, int cy, int r, Fun&& fun) const
+    {
+      if (r == 0) {
+        visit_column(cx, cy, cy, fun);
+        return;
+      }
+      visit_column(cx - r, cy - r, cy + r, fun);
+      for (int x = cx - r + 1; x < cx + r; ++x) {
+        visit_column(x, cy - r, cy - r, fun);
+        visit_column(x, cy + r, cy + r, fun);
+      }
+      visit_column(cx + r, cy - r, cy + r, fun);
+    }
+
+  private:
+    struct cell_entry
+    {
+      int cx, cy;     // cell
+      unsigned k;
+
+      bool operator<(const cell_entry& b) const noexcept
+      {
+        return (cx < b.cx) || (cx == b.cx && ((cy < b.cy) || (cy == b.cy && k < b.k)));
+      }
+    };
+
+    template <typename Fun>
+    void visit_column(int x, int y0, int y1, Fun&& fun) const
+    {
+      auto it = std::lower_bound(cells_.cbegin(), cells_.cend(), cell_entry{ x, y0, 0 });
+      for (; it != cells_.cend() && it->cx == x && it->cy <= y1; ++it) {
+        fun(it->k);
+      }
+    }
+
+    float inv_cell_ = 0.f;
+    std::vector<cell_entry> cells_;     // by cell, then k
+  };
+
+
+  // union-find over atomics, the root of a set is its smallest element
+  class union_find
+  {
+  public:
+    // n singletons
+    void reset(unsigned n)
+    {
+      parent_ = std::vector<std::atomic<unsigned>>(n);
+      tbb::parallel_for(tbb::blocked_range<unsigned>(0, n), [&](const auto& r) {
+        for (auto k = r.begin(); k < r.end(); ++k) parent_[k].store(k, std::memory_order_relaxed);
+      });
+    }
+
+    unsigned find(unsigned x) noexcept
+    {
+      for (;;) {
+        auto px = parent_[x].load();
+        if (px == x) return x;
+        const auto gx = parent_[px].load();
+        if (gx != px) parent_[x].compare_exchange_weak(px, gx);   // path halving
+        x = gx;
+      }
+    }
+
+    // false if a and b were in the same set
+    bool unite(unsigned a, unsigned b) noexcept
+    {
+      for (;;) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (a < b) std::swap(a, b);
+        auto expected = a;
+        if (parent_[a].compare_exchange_strong(expected, b)) return true;
+      }
+    }
+
+  private:
+    std::vector<std::atomic<unsigned>> parent_;
+  };
+
+
+  // counting sort of the agents by flock, flock_id[i] >= nf for none.
+  // members of flock f: members[offsets[f], offsets[f + 1]), ascending
+  inline void index_members(const std::vector<unsigned>& flock_id, size_t nf, std::vector<unsigned>& offsets, std::vector<unsigned>& members)
+  {
+    offsets.assign(nf + 1, 0);
+    for (const auto f : flock_id) {
+      if (f < nf) ++offsets[f + 1];
+    }
+    for (size_t f = 0; f < nf; ++f) offsets[f + 1] += offsets[f];
+    members.resize(offsets.back());
+    auto pos = std::vector<unsigned>(offsets.begin(), offsets.end() - 1);
+    for (unsigned i = 0; i < static_cast<unsigned>(flock_id.size()); ++i) {
+      const auto f = flock_id[i];
+      if (f < nf) members[pos[f]++] = i;
+    }
+  }
+
+}
+
+#endif
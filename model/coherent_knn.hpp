@@ -0,0 +1,122 @@
+#ifndef MODEL_COHERENT_KNN_HPP_INCLUDED
+#define MODEL_COHERENT_KNN_HPP_INCLUDED
+
+#include <vector>
+#include <atomic>
+#include <tbb/tbb.h>
+#include <glm/gtx/norm.hpp>
+#include <model/model.hpp>
+#include <model/kinematics.hpp>
+#include <model/checkpoint.hpp>
+
+
+namespace model {
+
+
+  // per agent bookkeeping of the coherent neighbor search.
+  // guard is a lower bound of the distance to any agent that is not in the
+  // neighborhood row, valid at the time of the last update.
+  struct coherent_info
+  {
+    vec3 pos = vec3(0);           // position at last update
+    glm::dvec3 drift = glm::dvec3(0);   // species drift at last update
+    double spread = 0.0;          // species spread at last update
+    float guard = -1.f;           // [m] < 0: no history
+  };
+
+
+  // tracks how far any agent of a species could have moved relative
+  // to the species' mean motion.
+  // drift:  accumulated mean displacement
+  // spread: accumulated maximum deviation from the mean displacement
+  // accumulated in double, only differences are meaningful.
+  class motion_bound
+  {
+  public:
+    glm::dvec3 drift() const noexcept { return drift_; }
+    double spread() const noexcept { return spread_; }
+
+    // restart tracking, previous records become meaningless
+    void reset()
+    {
+      last_pos_.clear();
+    }
+
+    // follows a reordering of the agents: new index k holds old index perm[k]
+    void permute(const std::vector<unsigned>& perm)
+    {
+      if (last_pos_.size() != perm.size()) return;
+      std::vector<vec3> tmp(perm.size());
+      for (size_t k = 0; k < perm.size(); ++k) tmp[k] = last_pos_[perm[k]];
+      last_pos_.swap(tmp);
+    }
+
+    // called once per tick before any agent is updated.
+    // the active set must not change between calls without reset().
+    void track(const kinematics& kin, const std::vector<unsigned>& active)
+    {
+      const auto n = active.size();
+      if (last_pos_.size() != kin.size()) {
+        last_pos_.resize(kin.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const auto& r) {
+          for (size_t k = r.begin(); k < r.end(); ++k) last_pos_[active[k]] = kin.pos(active[k]);
+        });
+        return;
+      }
+      if (n == 0) return;
+      const auto sum = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n), vec3(0), [&](const auto& r, vec3 s) {
+        for (size_t k = r.begin(); k < r.end(); ++k) s += kin.pos(active[k]) - last_pos_[active[k]];
+        return s;
+      }, std::plus<vec3>{});
+      const auto mean = sum / static_cast<float>(n);
+      const auto dev2 = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n), 0.f, [&](const auto& r, float d2) {
+        for (size_t k = r.begin(); k < r.end(); ++k) {
+          const auto i = active[k];
+          const auto pos = kin.pos(i);
+          d2 = std::max(d2, glm::length2((pos - last_pos_[i]) - mean));
+          last_pos_[i] = pos;
+        }
+        return d2;
+      }, [](float a, float b) { return std::max(a, b); });
+      drift_ += glm::dvec3(mean);
+      spread_ += std::sqrt(static_cast<double>(dev2));
+    }
+
+    void checkpoint(archive& ar) { ar(last_pos_, drift_, spread_); }
+
+  private:
+    std::vector<vec3> last_pos_;
+    glm::dvec3 drift_ = glm::dvec3(0);
+    double spread_ = 0.0;
+  };
+
+
+  // coherent neighbor search counters
+  struct coherent_stats
+  {
+    size_t incremental = 0;     // updates served from the previous neighborhood
+    size_t rebuilds = 0;        // full searches (incl. first update)
+  };
+
+
+  class coherent_counter
+  {
+  public:
+    void count(bool incremental) noexcept
+    {
+      (incremental ? incremental_ : rebuilds_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    coherent_stats stats() const noexcept
+    {
+      return { incremental_.load(std::memory_order_relaxed), rebuilds_.load(std::memory_order_relaxed) };
+    }
+
+  private:
+    std::atomic<size_t> incremental_ = 0;
+    std::atomic<size_t> rebuilds_ = 0;
+  };
+
+}
+
+#endif
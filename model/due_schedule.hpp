@@ -0,0 +1,92 @@
+#ifndef MODEL_DUE_SCHEDULE_HPP_INCLUDED
+#define MODEL_DUE_SCHEDULE_HPP_INCLUDED
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <model/model.hpp>
+
+
+namespace model {
+
+
+  // update scheduler counters
+  struct schedule_stats
+  {
+    size_t ticks = 0;           // scheduled ticks
+    size_t due = 0;             // agents updated, summed over ticks
+    size_t max_due = 0;         // largest per tick count
+    size_t last_due = 0;        // count of the last tick
+    double seconds = 0.0;       // [s] spent in the scheduler
+  };
+
+
+  // bucketed calendar of the next update ticks of a species.
+  // agent i sits in bucket (update_times[i] mod buckets); updates further
+  // ahead than the calendar stay in their bucket until their round comes.
+  // collect() hands out the agents due at T in ascending index order,
+  // which is storage order, i.e. spatial order if reordering is enabled.
+  class due_schedule
+  {
+  public:
+    static constexpr size_t buckets = 64;     // [ticks], power of 2
+
+    // recollect from the update times before the next collect().
+    // required if agents are (de)activated or reordered.
+    void invalidate() noexcept { valid_ = false; }
+
+    // agents with update_times[i] <= T, removed from the calendar
+    const std::vector<unsigned>& collect(const std::vector<tick_t>& uts, const std::vector<unsigned>& active, tick_t T)
+    {
+      const auto t0 = std::chrono::steady_clock::now();
+      if (!valid_) rebuild(uts, active, T);
+      auto& bucket = cal_[T & mask];
+      due_.clear();
+      size_t keep = 0;
+      for (const auto i : bucket) {
+        if (uts[i] <= T) due_.push_back(i);
+        else bucket[keep++] = i;    // next round
+      }
+      bucket.resize(keep);
+      std::sort(due_.begin(), due_.end());
+      stats_.ticks += 1;
+      stats_.due += due_.size();
+      stats_.max_due = std::max(stats_.max_due, due_.size());
+      stats_.last_due = due_.size();
+      stats_.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      return due_;
+    }
+
+    // re-inserts the agents handed out by the last collect()
+    void reschedule(const std::vector<tick_t>& uts, tick_t T)
+    {
+      const auto t0 = std::chrono::steady_clock::now();
+      for (const auto i : due_) insert(i, std::max(uts[i], T + 1));
+      stats_.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    const schedule_stats& stats() const noexcept { return stats_; }
+
+  private:
+    static constexpr tick_t mask = buckets - 1;
+    static_assert((buckets & mask) == 0);
+
+    void insert(unsigned i, tick_t t) { cal_[t & mask].push_back(i); }
+
+    void rebuild(const std::vector<tick_t>& uts, const std::vector<unsigned>& active, tick_t T)
+    {
+      for (auto& b : cal_) b.clear();
+      for (const auto i : active) insert(i, std::max(uts[i], T));
+      valid_ = true;
+    }
+
+    std::array<std::vector<unsigned>, buckets> cal_;
+    std::vector<unsigned> due_;
+    bool valid_ = false;
+    schedule_stats stats_;
+  };
+
+}
+
+#endif
@@ -10,9 +10,9 @@ namespace model {
   namespace flight_control {
 
     template <typename Agent>
-    void integrate_motion(Agent* self)
+    void integrate_motion(Agent* self, float dt)
     {
-      const float hdt = 0.5f * Simulation::dt(); // [tick]
+      const float hdt = 0.5f * dt; // [tick]
 
 	  // Cruise speed control as Drag
 	  const float dv_c = (self->sa.cruiseSpeed - self->speed);    // change in speed for cruise speed control [m / tick]
@@ -25,11 +25,11 @@ namespace model {
 	   
       // modified Euler method (a.k.a. midpoint method)
       vel += self->accel * hdt;                          // v(t + dt/2) = v(t) + a(t) dt/2
-      self->pos += vel * Simulation::dt();                 // r(t + dt) = r(t) + v(t + dt/2) * dt
+      self->pos += vel * dt;                 // r(t + dt) = r(t) + v(t + dt/2) * dt
       self->accel = (self->force + force) / self->ai.bodyMass;           // a(t + dt) = F(t + dt)/m
       vel += self->accel * hdt;                          // v(t) = v(t + dt/2) + a(t + dt) dt/2
 
-      self->ang_vel = math::rad_between_xy_max_rad(vel, self->dir) / Simulation::dt(); 
+      self->ang_vel = math::rad_between_xy_max_rad(vel, self->dir) / dt; 
 
       // clip speed & integrate
       self->speed = glm::length(vel);
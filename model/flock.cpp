@@ -1,8 +1,8 @@
 #include <queue>
 #include <algorithm>
+#include <tbb/tbb.h>
 #include <libs/math.hpp>
 #include <libs/space.hpp>
-#include <libs/graph.hpp>
 #include <glmutils/oobb.hpp>
 #include <agents/agents.hpp>
 #include <model/flock.hpp>
@@ -10,45 +10,203 @@
 
 namespace model {
 
-  void flock_tracker::cluster(float dd)
+  // calls fun(j) for all j != k closer than sqrt(dd) to k
+  template <typename Fun>
+  void flock_tracker::visit_near(unsigned k, float dd, Fun&& fun) const
   {
-    flock_id_.assign(proxy_.size(), no_flock);
-    const auto n = proxy_.size();
-    auto cc = graph::connected_components(0, static_cast<int>(n), [&](int i, int j) {
-      return dd > glm::distance2(proxy_[i].pos, proxy_[j].pos);
+    const auto& pos = proxy_[k].pos;
+    grid_.visit_cells(pos, [&](unsigned j) {
+      if (j != k && dd > glm::distance2(pos, proxy_[j].pos)) fun(j);
     });
-    descr_.clear();
-    for (unsigned ci = 0; ci < static_cast<unsigned>(cc.size()); ++ci) {
-      vpos_.clear();
-      vvel_.clear();
-      vec3 vel = vec3(0);
-      float pol = 0.f;
-      for (auto i : cc[ci]) {
-        flock_id_[proxy_[i].idx] = ci;
-        vpos_.emplace_back(space::ofs(proxy_[cc[ci][0]].pos, proxy_[i].pos));
-        vvel_.emplace_back(proxy_[i].vel);
-        vel += proxy_[i].vel;
+  }
+
+
+  void flock_tracker::components(float dd)
+  {
+    const auto n = static_cast<unsigned>(proxy_.size());
+    grid_.build(n, std::sqrt(dd), [&](unsigned k) { return proxy_[k].pos; });
+    union_find uf;
+    uf.reset(n);
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, n), [&](const auto& r) {
+      for (auto k = r.begin(); k < r.end(); ++k) {
+        visit_near(k, dd, [&](unsigned j) { if (k < j) uf.unite(k, j); });
+      }
+    });
+    // components in order of their smallest element
+    std::vector<unsigned> comp(n);
+    unsigned ncc = 0;
+    for (unsigned k = 0; k < n; ++k) {
+      const auto root = uf.find(k);
+      comp[k] = (root == k) ? ncc++ : comp[root];
+    }
+    cc_.resize(ncc);
+    std::vector<unsigned> pivot(ncc);
+    for (unsigned k = n; k-- > 0; ) pivot[comp[k]] = k;
+    // breadth first from the smallest element, unvisited neighbors ascending
+    std::vector<char> visited(n, 0);
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, ncc), [&](const auto& r) {
+      std::vector<unsigned> nb;
+      for (auto ci = r.begin(); ci < r.end(); ++ci) {
+        auto& c = cc_[ci];
+        c.clear();
+        c.push_back(pivot[ci]);
+        visited[pivot[ci]] = 1;
+        for (size_t head = 0; head < c.size(); ++head) {
+          nb.clear();
+          visit_near(c[head], dd, [&](unsigned j) { if (!visited[j]) nb.push_back(j); });
+          std::sort(nb.begin(), nb.end());
+          for (const auto j : nb) {
+            visited[j] = 1;
+            c.push_back(j);
+          }
+        }
+      }
+    });
+  }
+
+
+  void flock_tracker::match(tick_t tick)
+  {
+    const auto nc = static_cast<unsigned>(cc_.size());
+    const auto np = static_cast<unsigned>(prev_uid_.size());
+    overlap_.resize(nc);
+    tbb::parallel_for(tbb::blocked_range<unsigned>(0, nc), [&](const auto& r) {
+      std::vector<unsigned> from;
+      for (auto c = r.begin(); c < r.end(); ++c) {
+        from.clear();
+        for (const auto k : cc_[c]) {
+          const auto idx = proxy_[k].idx;
+          if (idx < prev_id_.size() && prev_id_[idx] < np) from.push_back(prev_id_[idx]);
+        }
+        std::sort(from.begin(), from.end());
+        auto& ov = overlap_[c];
+        ov.clear();
+        for (size_t i = 0; i < from.size(); ++i) {
+          if (i == 0 || from[i] != from[i - 1]) ov.emplace_back(from[i], 0);
+          ++ov.back().second;
+        }
+      }
+    });
+    // largest overlaps, ties to the smaller index
+    std::vector<unsigned> parent(nc, no_flock);
+    std::vector<std::pair<unsigned, unsigned>> successor(np, { no_flock, 0 });
+    for (unsigned c = 0; c < nc; ++c) {
+      unsigned best = 0;
+      for (const auto& [p, n] : overlap_[c]) {
+        if (n > best) { best = n; parent[c] = p; }
+        if (n > successor[p].second) successor[p] = { c, n };
       }
-      vec3 ext;
-      auto H = glmutils::oobb(static_cast<int>(cc[ci].size()), vpos_.begin(), ext);
-      vel /= cc[ci].size();
-      std::for_each(vvel_.begin(), vvel_.end(), [&](const auto& veli) { 
-      pol += glm::dot(math::save_normalize(veli, vec3(0.f)), math::save_normalize(vel, vec3(0.f))); });
-      pol /= cc[ci].size();
-      H[2] += glm::vec4(proxy_[cc[ci][0]].pos, 0.f);
-      descr_.push_back({ vpos_.size(), vel, pol, H, ext });
-      int x = 0;
     }
+    uid_.resize(nc);
+    events_.clear();
+    for (unsigned c = 0; c < nc; ++c) {
+      const auto p = parent[c];
+      const auto size = static_cast<unsigned>(cc_[c].size());
+      if (p != no_flock && successor[p].first == c) {
+        uid_[c] = prev_uid_[p];
+        continue;
+      }
+      uid_[c] = next_uid_++;
+      if (p == no_flock) events_.push_back({ tick, flock_event::birth, uid_[c], no_flock, size });
+      else events_.push_back({ tick, flock_event::split, uid_[c], prev_uid_[p], size });
+    }
+    for (unsigned p = 0; p < np; ++p) {
+      const auto c = successor[p].first;
+      if (c == no_flock) events_.push_back({ tick, flock_event::death, prev_uid_[p], no_flock, prev_size_[p] });
+      else if (uid_[c] != prev_uid_[p]) events_.push_back({ tick, flock_event::merge, prev_uid_[p], uid_[c], prev_size_[p] });
+    }
+  }
+
+
+  void flock_tracker::cluster(float dd, tick_t tick)
+  {
+    prev_id_.swap(flock_id_);
+    prev_uid_.swap(uid_);
+    prev_size_.resize(descr_.size());
+    for (size_t p = 0; p < descr_.size(); ++p) prev_size_[p] = static_cast<unsigned>(descr_[p].size);
+    flock_id_.assign(pop_size_, no_flock);
+    components(dd);
+    match(tick);
+    // cheap descriptors, in parallel over the flocks
+    const auto nc = cc_.size();
+    descr_.resize(nc);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nc), [&](const auto& r) {
+      for (auto ci = r.begin(); ci < r.end(); ++ci) {
+        const auto& c = cc_[ci];
+        const auto pivot = proxy_[c[0]].pos;
+        vec3 vel = vec3(0);
+        vec3 ofs = vec3(0);
+        for (const auto i : c) {
+          flock_id_[proxy_[i].idx] = static_cast<unsigned>(ci);
+          vel += proxy_[i].vel;
+          ofs += space::ofs(pivot, proxy_[i].pos);
+        }
+        const auto n = static_cast<float>(c.size());
+        descr_[ci] = { c.size(), vel / n, pivot + ofs / n };
+      }
+    });
+    index_members();
+    reset_shapes();
+    moved_ = 0;
+  }
+
+
+  flock_shape flock_tracker::shape(int id) const
+  {
+    std::call_once(shape_once_[id], [&] {
+      const auto& c = cc_[id];
+      const auto& fd = descr_[id];
+      const auto pivot = proxy_[c[0]].pos;
+      auto vpos = std::vector<vec3>(c.size());
+      float pol = 0.f;
+      const auto dir = math::save_normalize(fd.vel, vec3(0.f));
+      for (size_t j = 0; j < c.size(); ++j) {
+        vpos[j] = space::ofs(pivot, proxy_[c[j]].pos);
+        pol += glm::dot(math::save_normalize(proxy_[c[j]].vel, vec3(0.f)), dir);
+      }
+      auto& sh = shape_[id];
+      sh.pol = pol / c.size();
+      auto H = glmutils::oobb(static_cast<int>(c.size()), vpos.begin(), sh.ext);
+      H[2] += glm::vec4(pivot, 0.f);
+      sh.H = H;     // as of the pass
+    });
+    auto sh = shape_[id];
+    for (unsigned k = 0; k < moved_; ++k) sh.H[2] += step_ * descr_[id].vel;    // as track() moves the centroid
+    return sh;
+  }
+
+
+  void flock_tracker::reset_shapes()
+  {
+    shape_.assign(descr_.size(), flock_shape{});
+    shape_once_ = std::make_unique<std::once_flag[]>(descr_.size());
+  }
+
+
+  void flock_tracker::index_members()
+  {
+    model::index_members(flock_id_, descr_.size(), offsets_, members_);
+    for (size_t f = 0; f < descr_.size(); ++f) descr_[f].rep = members_[offsets_[f]];
+  }
+
+
+  void flock_tracker::permute(const std::vector<unsigned>& perm)
+  {
+    if (flock_id_.size() != perm.size()) return;
+    std::vector<unsigned> tmp(perm.size());
+    for (size_t k = 0; k < perm.size(); ++k) tmp[k] = flock_id_[perm[k]];
+    flock_id_.swap(tmp);
+    index_members();
   }
 
 
-  void flock_tracker::track()
+  void flock_tracker::track(float dt)
   {
-    const auto dt = Simulation::dt();
     for (auto& fd : descr_) {
-      vec3 gc = fd.gc();
-      fd.H[2] = gc + dt * fd.vel;
+      fd.centroid += dt * fd.vel;
     }
+    ++moved_;
+    step_ = dt;
   }
 
 }
@@ -1,8 +1,13 @@
 #ifndef MODEL_FLOCK_HPP_INCLUDED
 #define MODEL_FLOCK_HPP_INCLUDED
 
+#include <span>
+#include <mutex>
+#include <memory>
 #include <vector>
 #include <model/model.hpp>
+#include <model/clustering.hpp>
+#include <model/checkpoint.hpp>
 
 
 namespace model {
@@ -12,6 +17,14 @@ namespace model {
   {
     size_t size = 0;
     vec3 vel = vec3(0);  // velocity
+    vec3 centroid = vec3(0);  // mean member position
+    unsigned rep = 0;      // representative, smallest member index
+  };
+
+
+  // the expensive part of the description, see flock_tracker::shape
+  struct flock_shape
+  {
     float pol = 0.f;     // polarization
     glm::mat3x3 H;         // homogeneous transformation matrix flock -> Euclidean
 	  vec3 ext;
@@ -22,6 +35,19 @@ namespace model {
   constexpr unsigned no_flock = static_cast<unsigned>(-1);
 
 
+  // change of the flock identities by a clustering pass
+  struct flock_event
+  {
+    enum type_t : unsigned { birth, death, split, merge };
+
+    tick_t tick;
+    type_t type;
+    unsigned flock;     // persistent id
+    unsigned other;     // split: flock split from, merge: flock merged into, no_flock otherwise
+    unsigned size;      // birth, split: of the new flock, death, merge: of the vanished one
+  };
+
+
   class flock_tracker
   {
   public:
@@ -47,19 +73,63 @@ namespace model {
       return flock_id_[idx];
     }
 
-    void prepare(size_t n)
+    // computed on the first request after a clustering pass, thread safe.
+    // H moves with the flock as track() moves the centroids.
+    // id must be a valid flock id.
+    flock_shape shape(int id) const;
+
+    // member indices of flock id, ascending
+    std::span<const unsigned> members(int id) const noexcept
+    {
+      if (static_cast<size_t>(id) + 1 >= offsets_.size()) return {};
+      return { members_.data() + offsets_[id], members_.data() + offsets_[id + 1] };
+    }
+
+    // persistent id of flock id, kept over clustering passes
+    unsigned uid(int id) const noexcept
     {
+      return (static_cast<size_t>(id) < uid_.size()) ? uid_[id] : no_flock;
+    }
+
+    // events of the last clustering pass
+    const std::vector<flock_event>& events() const noexcept
+    {
+      return events_;
+    }
+
+    // pop_size agents, n of them clustered
+    void prepare(size_t pop_size, size_t n)
+    {
+      pop_size_ = pop_size;
       proxy_.assign(n, proxy{});
     }
 
+    // agent idx as the k-th of the clustered agents
     template <typename T>
-    void feed(const T& ind, size_t idx)
+    void feed(size_t k, const T& ind, size_t idx)
     {
-      proxy_[idx] = proxy(ind, idx);
+      proxy_[k] = proxy(ind, idx);
     }
 
-    void cluster(float dd);
-    void track();
+    // connected components of the clustered agents, 'connected' meaning
+    // closer than sqrt(dd). grid of cell size sqrt(dd) and concurrent union-find,
+    // same flocks and flock order as a breadth first search in index order.
+    // a flock keeps the persistent id of the previous flock it took most of
+    // its members from if that one passed most of its members to it.
+    void cluster(float dd, tick_t tick);
+    void track(float dt);
+
+    // follows a reordering of the agents: new index k holds old index perm[k]
+    void permute(const std::vector<unsigned>& perm);
+
+    void checkpoint(archive& ar)
+    {
+      ar(pop_size_, descr_, flock_id_, uid_, next_uid_, proxy_, cc_, moved_, step_);
+      if (ar.loading()) {
+        index_members();
+        reset_shapes();
+      }
+    }
 
   private:
     struct proxy 
@@ -75,11 +145,30 @@ namespace model {
 
       unsigned idx; vec3 pos, vel;
     };
+
+    void components(float dd);
+    void index_members();
+    void reset_shapes();
+    void match(tick_t tick);
+    template <typename Fun> void visit_near(unsigned k, float dd, Fun&& fun) const;
+
+    size_t pop_size_ = 0;
     std::vector<proxy> proxy_;
     std::vector<flock_descr> descr_;
-    std::vector<vec3> vpos_;
-    std::vector<vec3> vvel_;
     std::vector<unsigned> flock_id_;
+    cluster_grid grid_;                       // over proxy_
+    std::vector<std::vector<unsigned>> cc_;   // components, breadth first order
+    unsigned moved_ = 0;                      // track() calls since the last pass
+    float step_ = 0.f;                        // their dt
+    mutable std::vector<flock_shape> shape_;
+    mutable std::unique_ptr<std::once_flag[]> shape_once_;
+    std::vector<unsigned> offsets_;           // members_ of flock f: [offsets_[f], offsets_[f + 1])
+    std::vector<unsigned> members_;
+    std::vector<unsigned> uid_;               // persistent ids
+    unsigned next_uid_ = 0;
+    std::vector<flock_event> events_;
+    std::vector<unsigned> prev_id_, prev_uid_, prev_size_;    // previous pass
+    std::vector<std::vector<std::pair<unsigned, unsigned>>> overlap_;   // (previous flock, members) per flock
   };
 
 }
@@ -0,0 +1,229 @@
+#include <bit>
+#include <cmath>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <tbb/tbb.h>
+#include <libs/space.hpp>
+#include <glm/gtx/norm.hpp>
+#include <model/flock_hierarchy.hpp>
+
+
+namespace model {
+
+  flock_hierarchy::flock_hierarchy(std::vector<float> thresholds)
+  {
+    std::sort(thresholds.begin(), thresholds.end());
+    for (const auto t : thresholds) {
+      if (t <= 0.f) throw std::runtime_error("flockDetection: hierarchy thresholds must be positive");
+      levels_.emplace_back().threshold = t;
+    }
+  }
+
+
+  std::vector<float> flock_hierarchy::thresholds() const
+  {
+    std::vector<float> res;
+    for (const auto& lv : levels_) res.push_back(lv.threshold);
+    return res;
+  }
+
+
+  void flock_hierarchy::build(const kinematics& kin, const std::vector<unsigned>& active, tick_t tick)
+  {
+    if (!enabled()) return;
+    tick_ = tick;
+    const auto N = static_cast<unsigned>(kin.size());
+    union_find uf;
+    uf.reset(N);
+    spanning_forest(kin, active, uf);
+
+    // levels, growing the components along the forest
+    uf.reset(N);
+    size_t next = 0;
+    for (auto& lv : levels_) {
+      const auto t2 = lv.threshold * lv.threshold;
+      for (; next < forest_.size() && forest_[next].d2 < t2; ++next) {
+        uf.unite(forest_[next].a, forest_[next].b);
+      }
+      lv.flock_id.assign(N, no_flock);
+      lv.descr.clear();
+      std::vector<vec3> ofs;
+      for (const auto i : active) {
+        const auto root = uf.find(i);
+        if (root == i) {
+          lv.flock_id[i] = static_cast<unsigned>(lv.descr.size());
+          lv.descr.push_back({ 0, vec3(0), vec3(0), i });
+          ofs.push_back(vec3(0));
+        }
+        const auto f = lv.flock_id[i] = lv.flock_id[root];
+        auto& fd = lv.descr[f];
+        fd.size += 1;
+        fd.vel += kin.speed(i) * kin.dir(i);
+        ofs[f] += space::ofs(kin.pos(fd.rep), kin.pos(i));
+      }
+      for (size_t f = 0; f < lv.descr.size(); ++f) {
+        auto& fd = lv.descr[f];
+        const auto m = static_cast<float>(fd.size);
+        fd.vel /= m;
+        fd.centroid = kin.pos(fd.rep) + ofs[f] / m;
+      }
+      index_members(lv.flock_id, lv.descr.size(), lv.offsets, lv.members);
+    }
+  }
+
+
+  // Boruvka: every round joins each component to its nearest other component
+  // within the largest threshold. the agents search rings of cells outwards
+  // and stop beyond the shortest edge their component found so far. the other
+  // components only shrink: an agent keeps its nearest other agent while that
+  // one stays in another component, and the distance to the nearest other
+  // component never drops. agents already beyond the shortest edge of their
+  // component skip the search.
+  void flock_hierarchy::spanning_forest(const kinematics& kin, const std::vector<unsigned>& active, union_find& uf)
+  {
+    constexpr int rings = 3;      // cells per largest threshold
+    const auto n = static_cast<unsigned>(active.size());
+    const auto tmax = levels_.back().threshold;
+    const auto dd = tmax * tmax;
+    const auto cell = tmax / rings;
+    const auto none = edge{ std::numeric_limits<float>::infinity(), no_flock, no_flock };
+    grid_.build(n, cell, [&](unsigned k) { return kin.pos(active[k]); });
+    near_.assign(n, 0.f);
+    exact_.assign(n, 0);
+    best_.assign(n, none);
+    root_best_.assign(kin.size(), none);
+    auto bound = std::vector<std::atomic<unsigned>>(kin.size());   // by root, shortest edge found: positive floats order as their bits
+    forest_.clear();
+    for (bool joined = true; joined; ) {
+      for (const auto i : active) bound[i].store(std::bit_cast<unsigned>(dd), std::memory_order_relaxed);
+      const auto lower_bound = [&](unsigned root, const edge& e) {
+        const auto bits = std::bit_cast<unsigned>(e.d2);
+        for (auto cur = bound[root].load(); bits < cur && !bound[root].compare_exchange_weak(cur, bits); ) {}
+      };
+      tbb::parallel_for(tbb::blocked_range<unsigned>(0, n), [&](const auto& r) {
+        for (auto k = r.begin(); k < r.end(); ++k) {
+          auto& best = best_[k];
+          const auto i = active[k];
+          if (exact_[k] && uf.find(best.a == i ? best.b : best.a) != uf.find(i)) {
+            lower_bound(uf.find(i), best);      // still the nearest, the other components only shrink
+          }
+          else {
+            best = none;
+            exact_[k] = 0;
+          }
+        }
+      });
+      tbb::parallel_for(tbb::blocked_range<unsigned>(0, n), [&](const auto& r) {
+        for (auto k = r.begin(); k < r.end(); ++k) {
+          auto& best = best_[k];
+          const auto i = active[k];
+          const auto root = uf.find(i);
+          if (exact_[k] || near_[k] > std::bit_cast<float>(bound[root].load(std::memory_order_relaxed))) continue;
+          const auto pos = kin.pos(i);
+          const auto cx = grid_.cell_coor(pos.x);
+          const auto cy = grid_.cell_coor(pos.y);
+          auto skipped = std::numeric_limits<float>::infinity();    // nearest other component not looked at
+          for (int ring = 0; ring <= rings; ++ring) {
+            const auto b = std::min(best.d2, std::bit_cast<float>(bound[root].load(std::memory_order_relaxed)));
+            const auto lb = static_cast<float>(std::max(ring - 1, 0)) * cell;
+            if (lb * lb > b) {
+              skipped = std::min(skipped, lb * lb);
+              break;
+            }
+            grid_.visit_ring(cx, cy, ring, [&](unsigned j) {
+              const auto aj = active[j];
+              const auto d2 = glm::distance2(pos, kin.pos(aj));
+              if (d2 >= dd || uf.find(aj) == root) return;
+              if (d2 > b) skipped = std::min(skipped, d2);
+              else {
+                const auto e = edge{ d2, std::min(i, aj), std::max(i, aj) };
+                if (e < best) best = e;
+              }
+            });
+            lower_bound(root, best);
+          }
+          near_[k] = std::max(near_[k], std::min(best.d2, skipped));
+          exact_[k] = best.d2 < skipped;
+        }
+      });
+      roots_.clear();
+      for (unsigned k = 0; k < n; ++k) {
+        if (best_[k].a == no_flock) continue;
+        const auto root = uf.find(active[k]);
+        if (root_best_[root].a == no_flock) roots_.push_back(root);
+        if (best_[k] < root_best_[root]) root_best_[root] = best_[k];
+      }
+      joined = false;
+      for (const auto root : roots_) {
+        const auto& e = root_best_[root];
+        if (uf.unite(e.a, e.b)) {
+          forest_.push_back(e);
+          joined = true;
+        }
+      }
+      for (const auto root : roots_) root_best_[root] = none;
+    }
+    std::sort(forest_.begin(), forest_.end());
+  }
+
+
+  void flock_hierarchy::track(float dt)
+  {
+    for (auto& lv : levels_) {
+      for (auto& fd : lv.descr) fd.centroid += dt * fd.vel;
+    }
+  }
+
+
+  void flock_hierarchy::permute(const std::vector<unsigned>& perm)
+  {
+    if (!enabled()) return;
+    std::vector<unsigned> inv(perm.size());
+    for (unsigned k = 0; k < perm.size(); ++k) inv[perm[k]] = k;
+    for (auto& e : forest_) {
+      if (e.a < inv.size() && e.b < inv.size()) {
+        e.a = inv[e.a];
+        e.b = inv[e.b];
+        if (e.b < e.a) std::swap(e.a, e.b);
+      }
+    }
+    std::vector<unsigned> tmp(perm.size());
+    for (auto& lv : levels_) {
+      if (lv.flock_id.size() != perm.size()) continue;
+      for (size_t k = 0; k < perm.size(); ++k) tmp[k] = lv.flock_id[perm[k]];
+      lv.flock_id.swap(tmp);
+      index_members(lv.flock_id, lv.descr.size(), lv.offsets, lv.members);
+      for (size_t f = 0; f < lv.descr.size(); ++f) lv.descr[f].rep = lv.members[lv.offsets[f]];
+    }
+  }
+
+
+  void flock_hierarchy::checkpoint(archive& ar)
+  {
+    auto thresholds = this->thresholds();
+    ar(thresholds);
+    if (ar.loading() && thresholds != this->thresholds()) {
+      auto other = flock_hierarchy(thresholds);
+      ar(other.tick_, other.forest_, other.levels_);
+      clear();      // until the next pass
+      return;
+    }
+    ar(tick_, forest_, levels_);
+  }
+
+
+  void flock_hierarchy::clear()
+  {
+    tick_ = 0;
+    forest_.clear();
+    for (auto& lv : levels_) {
+      lv.flock_id.clear();
+      lv.descr.clear();
+      lv.offsets.clear();
+      lv.members.clear();
+    }
+  }
+
+}
@@ -0,0 +1,93 @@
+#ifndef MODEL_FLOCK_HIERARCHY_HPP_INCLUDED
+#define MODEL_FLOCK_HIERARCHY_HPP_INCLUDED
+
+#include <span>
+#include <vector>
+#include <model/model.hpp>
+#include <model/flock.hpp>
+#include <model/clustering.hpp>
+#include <model/kinematics.hpp>
+#include <model/checkpoint.hpp>
+
+
+namespace model {
+
+
+  // single-linkage flocks at several distance thresholds from one pass.
+  // the spanning forest is the Euclidean minimum spanning tree without the
+  // edges longer than the largest threshold (Boruvka over a grid of that
+  // cell size, edges ordered by length, then indices). the flocks at
+  // threshold t are the components of the forest edges shorter than t,
+  // i.e. the flocks of a flock_tracker at threshold t, numbered by their
+  // smallest member.
+  class flock_hierarchy
+  {
+  public:
+    struct edge
+    {
+      float d2;         // squared length
+      unsigned a, b;    // agent indices
+
+      bool operator<(const edge& e) const noexcept
+      {
+        return (d2 < e.d2) || (d2 == e.d2 && ((a < e.a) || (a == e.a && b < e.b)));
+      }
+    };
+
+    struct level
+    {
+      float threshold = 0.f;                // [m]
+      std::vector<unsigned> flock_id;       // by agent index, no_flock if not clustered
+      std::vector<flock_descr> descr;
+      std::vector<unsigned> offsets;        // members of flock f: [offsets[f], offsets[f + 1])
+      std::vector<unsigned> members;        // ascending per flock
+
+      std::span<const unsigned> members_of(size_t f) const noexcept
+      {
+        if (f + 1 >= offsets.size()) return {};
+        return { members.data() + offsets[f], members.data() + offsets[f + 1] };
+      }
+
+      void checkpoint(archive& ar) { ar(threshold, flock_id, descr, offsets, members); }
+    };
+
+    flock_hierarchy() {}
+    explicit flock_hierarchy(std::vector<float> thresholds);
+
+    bool enabled() const noexcept { return !levels_.empty(); }
+    std::vector<float> thresholds() const;
+
+    tick_t tick() const noexcept { return tick_; }                      // of the last pass
+    const std::vector<edge>& forest() const noexcept { return forest_; }  // ascending length
+    const std::vector<level>& levels() const noexcept { return levels_; }  // ascending threshold
+
+    // clusters the active agents
+    void build(const kinematics& kin, const std::vector<unsigned>& active, tick_t tick);
+
+    // moves the centroids with the flocks, see flock_tracker::track
+    void track(float dt);
+
+    // follows a reordering of the agents: new index k holds old index perm[k]
+    void permute(const std::vector<unsigned>& perm);
+
+    // a state saved with other thresholds is dropped
+    void checkpoint(archive& ar);
+
+  private:
+    void spanning_forest(const kinematics& kin, const std::vector<unsigned>& active, union_find& uf);
+    void clear();
+
+    tick_t tick_ = 0;
+    std::vector<edge> forest_;
+    std::vector<level> levels_;
+    cluster_grid grid_;                 // over active, cells of a fraction of the largest threshold
+    std::vector<float> near_;           // by k: lower bound of the squared distance to another component, inf: none in reach
+    std::vector<char> exact_;           // by k: best_ is the nearest agent of another component
+    std::vector<edge> best_;            // by k: shortest edge to another component found
+    std::vector<edge> root_best_;       // by agent index: shortest edge of the component rooted there
+    std::vector<unsigned> roots_;
+  };
+
+}
+
+#endif
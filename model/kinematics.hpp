@@ -0,0 +1,72 @@
+#ifndef MODEL_KINEMATICS_HPP_INCLUDED
+#define MODEL_KINEMATICS_HPP_INCLUDED
+
+#include <vector>
+#include <tbb/tbb.h>
+#include <model/model.hpp>
+
+
+namespace model {
+
+
+  // hot kinematic state of a species as structure of arrays.
+  // mirrors pos, dir and speed of the agents as of the last integration,
+  // snapshot or reordering. the neighbor search streams from here instead
+  // of dragging the agents through the cache.
+  class kinematics
+  {
+  public:
+    size_t size() const noexcept { return x_.size(); }
+
+    vec3 pos(size_t i) const noexcept { return vec3(x_[i], y_[i], z_[i]); }
+    vec3 dir(size_t i) const noexcept { return vec3(dx_[i], dy_[i], dz_[i]); }
+    float speed(size_t i) const noexcept { return speed_[i]; }
+
+    // contiguous components
+    const float* x() const noexcept { return x_.data(); }
+    const float* y() const noexcept { return y_.data(); }
+    const float* z() const noexcept { return z_.data(); }
+
+    // squared euclidean distances from pos to all agents, vectorizable
+    void distance2(const vec3& pos, float* out) const noexcept
+    {
+      const auto n = size();
+      const float* x = x_.data();
+      const float* y = y_.data();
+      const float* z = z_.data();
+      for (size_t i = 0; i < n; ++i) {
+        const float dx = x[i] - pos.x;
+        const float dy = y[i] - pos.y;
+        const float dz = z[i] - pos.z;
+        out[i] = dx * dx + dy * dy + dz * dz;
+      }
+    }
+
+    template <typename Agent>
+    void store(size_t i, const Agent& a) noexcept
+    {
+      x_[i] = a.pos.x; y_[i] = a.pos.y; z_[i] = a.pos.z;
+      dx_[i] = a.dir.x; dy_[i] = a.dir.y; dz_[i] = a.dir.z;
+      speed_[i] = a.speed;
+    }
+
+    // refresh from the whole population
+    template <typename Pop>
+    void store(const Pop& pop)
+    {
+      const auto n = pop.size();
+      for (auto* v : { &x_, &y_, &z_, &dx_, &dy_, &dz_, &speed_ }) v->resize(n);
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const auto& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) store(i, pop[i]);
+      });
+    }
+
+  private:
+    std::vector<float> x_, y_, z_;
+    std::vector<float> dx_, dy_, dz_;
+    std::vector<float> speed_;
+  };
+
+}
+
+#endif
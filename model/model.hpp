@@ -8,27 +8,39 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <libs/rndutils.hpp>
+#include <model/rng.hpp>
 #include <agents/agents_fwd.hpp>
 
 
 namespace model {
 
-  extern thread_local rndutils::default_engine reng;
+  extern thread_local rng_engine reng;
   static constexpr size_t n_species = std::tuple_size_v<species_pop>;
 
 
+  template <typename T, typename Tuple>
+  struct tuple_contains;
+
+  template <typename T, typename... Ts>
+  struct tuple_contains<T, std::tuple<Ts...>> : std::bool_constant<(std::is_same_v<T, Ts> || ...)> {};
+
+  // true if species S1 declares S2 in neighbor_species
+  template <size_t S1, size_t S2>
+  inline constexpr bool has_neighbors = tuple_contains<
+    std::integral_constant<size_t, S2>,
+    typename neighbor_species<std::integral_constant<size_t, S1>>::type
+  >::value;
+
+
+  // hot part of a neighbor row entry.
+  // cold per neighbor state (state, timers) is read from the agent via idx.
   struct neighbor_info
   {
     float dist2;      // distance square
     unsigned idx;     // index of neighbor
     float bangl;       // angle from focal individual
-
-    // For copying escape mechanism:
-    bool is_esc;    // is neighbor in escape state?
-    int state;          // neighbor's state, used for copying
-    tick_t esc_t_left;      // time left in escape, used for copying
-
   };
+  static_assert(sizeof(neighbor_info) == 12);
 
 
   class neighbor_info_view
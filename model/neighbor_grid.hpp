@@ -0,0 +1,193 @@
+#ifndef MODEL_NEIGHBOR_GRID_HPP_INCLUDED
+#define MODEL_NEIGHBOR_GRID_HPP_INCLUDED
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <tbb/tbb.h>
+#include <glm/gtx/norm.hpp>
+#include <model/model.hpp>
+#include <model/kinematics.hpp>
+
+
+namespace model {
+
+
+  // uniform grid (cell list) over the xy-plane.
+  // cells are hashed into a table of 2^n buckets, thus the grid is unbounded.
+  class neighbor_grid
+  {
+  public:
+    struct entry
+    {
+      unsigned bucket;
+      int cx, cy;     // cell
+      unsigned idx;   // index into population
+      vec3 pos;
+    };
+
+    neighbor_grid() {}
+
+    float cell_size() const noexcept { return cell_size_; }
+    size_t size() const noexcept { return entries_.size(); }
+
+    void set_cell_size(float cell_size)
+    {
+      cell_size_ = cell_size;
+      inv_cell_size_ = 1.f / cell_size;
+    }
+
+    // rebuilds the grid from the positions of the active agents
+    void build(const kinematics& kin, const std::vector<unsigned>& active)
+    {
+      const auto n = active.size();
+      size_t buckets = 16;
+      while (buckets < 2 * n) buckets <<= 1;
+      mask_ = static_cast<unsigned>(buckets - 1);
+      entries_.resize(n);
+      begin_.assign(buckets, 0);
+      end_.assign(buckets, 0);
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const auto& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          auto& e = entries_[i];
+          e.idx = active[i];
+          e.pos = kin.pos(e.idx);
+          e.cx = cell_coor(e.pos.x);
+          e.cy = cell_coor(e.pos.y);
+          e.bucket = hash(e.cx, e.cy);
+        }
+      });
+      tbb::parallel_sort(entries_.begin(), entries_.end(), [](const entry& a, const entry& b) {
+        return (a.bucket < b.bucket) || ((a.bucket == b.bucket) && (a.idx < b.idx));
+      });
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const auto& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          const auto b = entries_[i].bucket;
+          if (i == 0 || entries_[i - 1].bucket != b) begin_[b] = static_cast<unsigned>(i);
+          if (i == n - 1 || entries_[i + 1].bucket != b) end_[b] = static_cast<unsigned>(i + 1);
+        }
+      });
+      auto bbox = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n), empty_bbox(), [&](const auto& r, glm::ivec4 bb) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          bb = merge(bb, glm::ivec4(entries_[i].cx, entries_[i].cy, entries_[i].cx, entries_[i].cy));
+        }
+        return bb;
+      }, &neighbor_grid::merge);
+      bbox_ = bbox;
+    }
+
+    // empty until the next build
+    void clear()
+    {
+      entries_.clear();
+    }
+
+    int cell_coor(float x) const noexcept
+    {
+      return static_cast<int>(std::floor(x * inv_cell_size_));
+    }
+
+    // range of rings around cell (cx, cy) that may contain occupied cells
+    glm::ivec2 ring_range(int cx, int cy) const noexcept
+    {
+      if (entries_.empty()) return glm::ivec2(0, -1);
+      const int rmin = std::max(0, std::max(std::max(bbox_.x - cx, cx - bbox_.z), std::max(bbox_.y - cy, cy - bbox_.w)));
+      const int rmax = std::max(std::max(cx - bbox_.x, bbox_.z - cx), std::max(cy - bbox_.y, bbox_.w - cy));
+      return glm::ivec2(rmin, rmax);
+    }
+
+    // calls fun(const entry&) for every entry in cell (cx, cy)
+    template <typename Fun>
+    void visit_cell(int cx, int cy, Fun&& fun) const
+    {
+      const auto b = hash(cx, cy);
+      for (auto i = begin_[b]; i < end_[b]; ++i) {
+        const auto& e = entries_[i];
+        if (e.cx == cx && e.cy == cy) fun(e);   // skip hash collisions
+      }
+    }
+
+    // calls fun(const entry&) for every entry in the cells at Chebyshev distance r from (cx, cy)
+    // cells outside the occupied bounding box are skipped
+    template <typename Fun>
+    void visit_ring(int cx, int cy, int r, Fun&& fun) const
+    {
+      if (r == 0) {
+        visit_cell(cx, cy, fun);
+        return;
+      }
+      const int x0 = std::max(cx - r, bbox_.x), x1 = std::min(cx + r, bbox_.z);
+      for (const int y : { cy - r, cy + r }) {
+        if (y < bbox_.y || y > bbox_.w) continue;
+        for (int x = x0; x <= x1; ++x) visit_cell(x, y, fun);
+      }
+      const int y0 = std::max(cy - r + 1, bbox_.y), y1 = std::min(cy + r - 1, bbox_.w);
+      for (const int x : { cx - r, cx + r }) {
+        if (x < bbox_.x || x > bbox_.z) continue;
+        for (int y = y0; y <= y1; ++y) visit_cell(x, y, fun);
+      }
+    }
+
+    // collects the k nearest entries within maxdist2 of pos, nearest first.
+    // searches outward ring by ring until the k-th candidate is closer
+    // than any unvisited cell or maxdist is reached.
+    // the result is written to [buf.begin(), buf.begin() + return value)
+    // as partially filled neighbor_info {dist2, idx}.
+    template <typename Skip>
+    size_t knn(const vec3& pos, size_t k, float maxdist2, std::vector<neighbor_info>& buf, Skip&& skip) const
+    {
+      buf.clear();
+      if (k == 0) return 0;
+      const int cx = cell_coor(pos.x);
+      const int cy = cell_coor(pos.y);
+      const auto rr = ring_range(cx, cy);
+      const auto by_dist = [](const neighbor_info& a, const neighbor_info& b) { return a.dist2 < b.dist2; };
+      for (int r = rr.x; r <= rr.y; ++r) {
+        visit_ring(cx, cy, r, [&](const entry& e) {
+          const auto dd = glm::distance2(pos, e.pos);
+          if (dd <= maxdist2 && !skip(e.idx)) {
+            buf.push_back(neighbor_info{ dd, e.idx });
+          }
+        });
+        // unvisited entries are at least r cells away
+        const float clearance = static_cast<float>(r) * cell_size_;
+        if (clearance * clearance >= maxdist2) break;
+        if (buf.size() >= k) {
+          std::nth_element(buf.begin(), buf.begin() + (k - 1), buf.end(), by_dist);
+          if (buf[k - 1].dist2 <= clearance * clearance) break;
+        }
+      }
+      const auto m = std::min(k, buf.size());
+      std::partial_sort(buf.begin(), buf.begin() + m, buf.end(), by_dist);
+      buf.resize(m);
+      return m;
+    }
+
+  private:
+    unsigned hash(int cx, int cy) const noexcept
+    {
+      return ((static_cast<unsigned>(cx) * 73856093u) ^ (static_cast<unsigned>(cy) * 19349663u)) & mask_;
+    }
+
+    static glm::ivec4 empty_bbox() noexcept
+    {
+      return glm::ivec4(std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min());
+    }
+
+    static glm::ivec4 merge(const glm::ivec4& a, const glm::ivec4& b) noexcept
+    {
+      return glm::ivec4(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w));
+    }
+
+    float cell_size_ = 1.f;
+    float inv_cell_size_ = 1.f;
+    unsigned mask_ = 0;
+    glm::ivec4 bbox_ = empty_bbox();   // occupied cells {min x, min y, max x, max y}
+    std::vector<entry> entries_;       // sorted by bucket
+    std::vector<unsigned> begin_;      // per bucket
+    std::vector<unsigned> end_;        // per bucket
+  };
+
+}
+
+#endif
@@ -2,7 +2,11 @@
 #define MODEL_OBSERVER_HPP_INCLUDED
 
 #include <deque>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
 #include <model/json.hpp>
+#include <model/checkpoint.hpp>
 
 
 namespace model {
@@ -32,6 +36,12 @@ namespace model {
       if (next_) next_->notify_once(sim);
     }
 
+    // part of the checkpoint, see Simulation::checkpoint
+    virtual void checkpoint(archive& ar, const class Simulation& sim)
+    {
+      if (next_) next_->checkpoint(ar, sim);
+    }
+
   private:
     Observer* next_ = nullptr;
     Observer* parent_ = nullptr;
@@ -42,12 +52,13 @@ namespace model {
   {
   public:
 
-      AnalysisObserver(const std::filesystem::path& out_path, const json& J)
+      // dt: time step of the observed simulation [s]
+      AnalysisObserver(const std::filesystem::path& out_path, const json& J, float dt)
       {
           const std::string out_name = J["output_name"];
           full_out_path_ = (out_path / (out_name + ".csv")).string();
-          const float freq_sec = J["sample_freq"];
-          oi_.sample_tick = oi_.sample_freq = static_cast<tick_t>(freq_sec / model::Simulation::dt());
+          const float freq_sec = J.value("sample_freq", dt);
+          oi_.sample_tick = oi_.sample_freq = static_cast<tick_t>(freq_sec / dt);
       }
       virtual ~AnalysisObserver() {};
 
@@ -97,7 +108,48 @@ namespace model {
 		  notify_next(lmsg, sim);
 	  }
 
+      // writes out what is buffered before saving. restoring rewinds
+      // the output to the state of the checkpoint.
+      void checkpoint(archive& ar, const model::Simulation& sim) override
+      {
+        if (!ar.loading()) {
+          notify_save(sim);
+          data_out_.clear();
+        }
+        ar(oi_);
+        checkpoint_output(ar);
+        Observer::checkpoint(ar, sim);
+      }
+
   protected:
+    // opens the output, a resumed run continues the existing file
+    void open_output(const std::string& header)
+    {
+      if (std::filesystem::exists(full_out_path_)) {
+        outfile_stream_.open(full_out_path_, std::ios::app);
+        return;
+      }
+      outfile_stream_.open(full_out_path_);
+      outfile_stream_ << header << std::endl;
+    }
+
+    // the output written so far: the size of the output file
+    virtual void checkpoint_output(archive& ar)
+    {
+      if (!outfile_stream_.is_open()) return;
+      std::uint64_t size = 0;
+      if (!ar.loading()) {
+        outfile_stream_.flush();
+        size = static_cast<std::uint64_t>(outfile_stream_.tellp());
+      }
+      ar(size);
+      if (ar.loading()) {
+        outfile_stream_.close();
+        std::filesystem::resize_file(full_out_path_, size);
+        outfile_stream_.open(full_out_path_, std::ios::app);
+      }
+    }
+
     virtual void notify_init(const model::Simulation&) {};
     virtual void notify_tick(const model::Simulation&) {};
     virtual void notify_pre_tick(const model::Simulation&) {};
@@ -0,0 +1,225 @@
+#ifndef MODEL_RNG_HPP_INCLUDED
+#define MODEL_RNG_HPP_INCLUDED
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <libs/rndutils.hpp>
+
+
+namespace model {
+
+
+  // Philox4x32-10 counter based generator.
+  // Salmon et al. (2011) Parallel random numbers: as easy as 1, 2, 3.
+  namespace philox {
+
+    using ctr_t = std::array<uint32_t, 4>;
+    using key_t = std::array<uint32_t, 2>;
+
+    inline ctr_t block(ctr_t c, key_t k) noexcept
+    {
+      for (int r = 0; r < 10; ++r) {
+        const uint64_t p0 = uint64_t(0xD2511F53) * c[0];
+        const uint64_t p1 = uint64_t(0xCD9E8D57) * c[2];
+        c = { uint32_t(p1 >> 32) ^ c[1] ^ k[0], uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k[1], uint32_t(p0) };
+        k[0] += 0x9E3779B9;
+        k[1] += 0xBB67AE85;
+      }
+      return c;
+    }
+
+    // seed of the branch 'branch' of a run seeded with 'seed'
+    inline uint64_t branch_seed(uint64_t seed, uint64_t branch) noexcept
+    {
+      const auto b = block({ uint32_t(branch), uint32_t(branch >> 32), 0, 0 }, { uint32_t(seed), uint32_t(seed >> 32) });
+      return (uint64_t(b[0]) << 32) | b[1];
+    }
+
+  }
+
+
+  // random engine of the model, one per thread (model::reng).
+  // outside an rng_scope it forwards to a sequential rndutils::default_engine.
+  // inside, it draws philox::block({ n, tick, id, species }, seed) for n = 0, 1, ...
+  // that is, the draws depend on (seed, species, id, tick, draw index) only,
+  // not on the thread or on the order of the agents.
+  class rng_engine
+  {
+  public:
+    using result_type = rndutils::default_engine::result_type;
+    static constexpr result_type (min)() { return 0; }
+    static constexpr result_type (max)() { return std::numeric_limits<result_type>::max(); }
+
+    explicit rng_engine(const rndutils::default_engine& eng) : eng_(eng) {}
+
+    result_type operator()() noexcept
+    {
+      if (!s_.active) return eng_();
+      if (s_.lane == 4) refill();
+      const auto r = (uint64_t(s_.block[s_.lane]) << 32) | s_.block[s_.lane + 1];
+      s_.lane += 2;
+      return r;
+    }
+
+    // bulk variates, vectorizable if counter based.
+    void uniform(float* out, size_t n, float a = 0.f, float b = 1.f)
+    {
+      fill(out, n, [a, s = b - a](uint32_t x) { return a + s * u01(x); });
+    }
+
+    // Box-Muller
+    void normal(float* out, size_t n, float mean = 0.f, float sd = 1.f)
+    {
+      uint32_t buf[chunk];
+      for (size_t k = 0; k < n; k += chunk) {
+        const auto m = std::min(chunk, n - k);
+        fill_u32(buf, (m + 1) & ~size_t(1));
+        for (size_t j = 0; j < m; j += 2) {
+          const auto r = sd * std::sqrt(-2.f * std::log(u01c(buf[j])));
+          const auto phi = two_pi * u01(buf[j + 1]);
+          out[k + j] = mean + r * std::cos(phi);
+          if (j + 1 < m) out[k + j + 1] = mean + r * std::sin(phi);
+        }
+      }
+    }
+
+    // Marsaglia & Tsang (2000), shape alpha, scale beta
+    void gamma(float* out, size_t n, float alpha, float beta = 1.f)
+    {
+      const auto boost = alpha < 1.f;
+      const auto d = (boost ? alpha + 1.f : alpha) - 1.f / 3.f;
+      const auto c = 1.f / std::sqrt(9.f * d);
+      for (size_t k = 0; k < n; ++k) {
+        float v = 0.f;
+        for (;;) {
+          const auto r = (*this)();
+          const auto z = std::sqrt(-2.f * std::log(u01c(uint32_t(r >> 32)))) * std::cos(two_pi * u01(uint32_t(r)));
+          v = 1.f + c * z;
+          if (v <= 0.f) continue;
+          v = v * v * v;
+          const auto u = u01c(uint32_t((*this)() >> 32));
+          if (std::log(u) < 0.5f * z * z + d - d * v + d * std::log(v)) break;
+        }
+        out[k] = d * v * beta;
+        if (boost) out[k] *= std::pow(u01c(uint32_t((*this)() >> 32)), 1.f / alpha);
+      }
+    }
+
+  private:
+    friend class rng_scope;
+    friend class rng_engine_scope;
+    static constexpr size_t chunk = 64;
+    static constexpr float two_pi = 6.28318531f;
+
+    struct stream_t
+    {
+      bool active = false;
+      philox::key_t key = {};
+      philox::ctr_t ctr = {};
+      philox::ctr_t block = {};
+      unsigned lane = 4;
+    };
+
+    static float u01(uint32_t x) noexcept { return float(x >> 8) * 0x1p-24f; }           // [0, 1)
+    static float u01c(uint32_t x) noexcept { return float((x >> 8) + 1) * 0x1p-24f; }    // (0, 1]
+
+    void refill() noexcept
+    {
+      s_.block = philox::block(s_.ctr, s_.key);
+      ++s_.ctr[0];
+      s_.lane = 0;
+    }
+
+    // whole blocks of the stream, the rest of the current block is skipped
+    void fill_u32(uint32_t* out, size_t n) noexcept
+    {
+      if (s_.active) {
+        s_.lane = 4;
+        for (size_t k = 0; k < n; k += 4) {
+          const auto b = philox::block(s_.ctr, s_.key);
+          ++s_.ctr[0];
+          for (size_t j = 0; j < 4 && k + j < n; ++j) out[k + j] = b[j];
+        }
+      }
+      else {
+        for (size_t k = 0; k < n; k += 2) {
+          const auto r = eng_();
+          out[k] = uint32_t(r >> 32);
+          if (k + 1 < n) out[k + 1] = uint32_t(r);
+        }
+      }
+    }
+
+    template <typename Fun>
+    void fill(float* out, size_t n, Fun&& fun)
+    {
+      uint32_t buf[chunk];
+      for (size_t k = 0; k < n; k += chunk) {
+        const auto m = std::min(chunk, n - k);
+        fill_u32(buf, m);
+        for (size_t j = 0; j < m; ++j) out[k + j] = fun(buf[j]);
+      }
+    }
+
+    rndutils::default_engine eng_;
+    stream_t s_;
+  };
+
+
+  // routes the draws of the calling thread's engine to the stream
+  // (seed, species, id, tick) for its lifetime. no-op if !counter.
+  class rng_scope
+  {
+  public:
+    rng_scope(rng_engine& eng, bool counter, uint64_t seed, uint32_t species, uint32_t id, uint64_t tick) noexcept :
+      eng_(eng), saved_(eng.s_)
+    {
+      if (counter) {
+        auto& s = eng.s_;
+        s.active = true;
+        s.key = { uint32_t(seed), uint32_t(seed >> 32) };
+        s.ctr = { 0, uint32_t(tick), id, species };
+        s.lane = 4;
+      }
+    }
+
+    ~rng_scope() { eng_.s_ = saved_; }
+
+    rng_scope(const rng_scope&) = delete;
+    rng_scope& operator=(const rng_scope&) = delete;
+
+  private:
+    rng_engine& eng_;
+    const rng_engine::stream_t saved_;
+  };
+
+
+  // lends 'own' to the calling thread's engine for its lifetime: the draws
+  // outside rng_scopes come from 'own', which keeps the state they leave.
+  // no-op if own == nullptr.
+  class rng_engine_scope
+  {
+  public:
+    rng_engine_scope(rng_engine& eng, rndutils::default_engine* own) noexcept :
+      eng_(eng), own_(own)
+    {
+      if (own_) std::swap(eng_.eng_, *own_);
+    }
+
+    ~rng_engine_scope() { if (own_) std::swap(eng_.eng_, *own_); }
+
+    rng_engine_scope(const rng_engine_scope&) = delete;
+    rng_engine_scope& operator=(const rng_engine_scope&) = delete;
+
+  private:
+    rng_engine& eng_;
+    rndutils::default_engine* own_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <model/row_kernel.hpp>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace model {
+  namespace row_kernel {
+
+    void scalar(const query& q, float* dist2, float* bearing)
+    {
+      for (size_t k = 0; k < q.n; ++k) {
+        const auto j = q.idx ? q.idx[k] : k;
+        const float ox = q.x[j] - q.pos[0];
+        const float oy = q.y[j] - q.pos[1];
+        const float oz = q.z[j] - q.pos[2];
+        dist2[k] = ox * ox + oy * oy + oz * oz;
+        bearing[k] = fast_atan2(q.dir[0] * oy - q.dir[1] * ox, q.dir[0] * ox + q.dir[1] * oy + q.dir[2] * oz);
+      }
+    }
+
+
+    query tail(const query& q, size_t first) noexcept
+    {
+      auto t = q;
+      t.n = q.n - first;
+      if (q.idx) {
+        t.idx = q.idx + first;
+      }
+      else {
+        t.x = q.x + first;
+        t.y = q.y + first;
+        t.z = q.z + first;
+      }
+      return t;
+    }
+
+
+    namespace {
+
+#ifdef _MSC_VER
+      bool cpu_has(Isa isa) noexcept
+      {
+        if (isa == Isa::Scalar) return true;
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7) return false;
+        __cpuid(r, 1);
+        const bool osxsave = (r[2] & (1 << 27)) != 0;
+        const bool avx = (r[2] & (1 << 28)) != 0;
+        if (!(osxsave && avx)) return false;
+        const auto xcr0 = _xgetbv(0);
+        if ((xcr0 & 0x6) != 0x6) return false;        // xmm, ymm state
+        __cpuidex(r, 7, 0);
+        if (isa == Isa::AVX2) return (r[1] & (1 << 5)) != 0;
+        return ((r[1] & (1 << 16)) != 0) && ((xcr0 & 0xe6) == 0xe6);   // avx512f, opmask & zmm state
+      }
+#else
+      bool cpu_has(Isa isa) noexcept
+      {
+        __builtin_cpu_init();
+        if (isa == Isa::AVX2) return __builtin_cpu_supports("avx2");
+        if (isa == Isa::AVX512) return __builtin_cpu_supports("avx512f");
+        return true;
+      }
+#endif
+
+    }
+
+
+    Isa host_isa() noexcept
+    {
+      static const Isa isa = cpu_has(Isa::AVX512) ? Isa::AVX512 : (cpu_has(Isa::AVX2) ? Isa::AVX2 : Isa::Scalar);
+      return isa;
+    }
+
+
+    const char* name(Isa isa) noexcept
+    {
+      switch (isa) {
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+        default: return "scalar";
+      }
+    }
+
+
+    kernel_fn select(Isa isa) noexcept
+    {
+      if (isa == Isa::AVX512) {
+        if (cpu_has(Isa::AVX512)) return &avx512;
+        isa = Isa::AVX2;
+      }
+      if (isa == Isa::AVX2 && cpu_has(Isa::AVX2)) return &avx2;
+      return &scalar;
+    }
+
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef MODEL_ROW_KERNEL_HPP_INCLUDED
+#define MODEL_ROW_KERNEL_HPP_INCLUDED
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+
+namespace model {
+
+
+  // per pair part of the neighbor row construction:
+  //
+  //   ofs        = p_k - pos
+  //   dist2[k]   = dot(ofs, ofs)
+  //   bearing[k] = atan2(perpDot(dir, ofs), dot(dir, ofs))
+  //
+  // for the candidates p_k = (x[idx[k]], y[idx[k]], z[idx[k]]).
+  // the bearing is approximated by fast_atan2(), the kernels agree up to rounding.
+  // kept free of glm: the vectorized kernels are compiled with ISA flags.
+  namespace row_kernel {
+
+    enum class Isa {
+      Scalar,
+      AVX2,       // 8 pairs per instruction
+      AVX512      // 16 pairs per instruction
+    };
+
+    struct query
+    {
+      float pos[3];               // focal agent
+      float dir[3];
+      const float* x;             // candidate positions, structure of arrays
+      const float* y;
+      const float* z;
+      const unsigned* idx;        // candidates, nullptr: 0, 1, ... n-1
+      size_t n;
+    };
+
+    using kernel_fn = void (*)(const query& q, float* dist2, float* bearing);
+
+    void scalar(const query& q, float* dist2, float* bearing);
+    void avx2(const query& q, float* dist2, float* bearing);
+    void avx512(const query& q, float* dist2, float* bearing);
+
+    // the candidates [first, q.n) of q
+    query tail(const query& q, size_t first) noexcept;
+
+    // best instruction set supported by cpu and os
+    Isa host_isa() noexcept;
+    const char* name(Isa isa) noexcept;
+
+    // kernel for isa, falls back to the next smaller isa the host supports
+    kernel_fn select(Isa isa) noexcept;
+
+
+    // minimax polynomial for atan(z), z in [0, 1]
+    constexpr float atan_c[] = { 0.99997726f, -0.33262347f, 0.19354346f, -0.11643287f, 0.05265332f, -0.01172120f };
+    constexpr float half_pi = 1.57079633f;
+    constexpr float pi = 3.14159265f;
+
+    // atan2 approximation, absolute error < 2.5e-6 rad.
+    // fast_atan2(0, 0) == 0.
+    inline float fast_atan2(float y, float x) noexcept
+    {
+      const float ax = std::abs(x);
+      const float ay = std::abs(y);
+      const float mx = std::max(ax, ay);
+      const float z = (mx > 0.f) ? std::min(ax, ay) / mx : 0.f;
+      const float s = z * z;
+      float p = atan_c[5];
+      p = p * s + atan_c[4];
+      p = p * s + atan_c[3];
+      p = p * s + atan_c[2];
+      p = p * s + atan_c[1];
+      p = p * s + atan_c[0];
+      float r = z * p;
+      if (ay > ax) r = half_pi - r;
+      if (x < 0.f) r = pi - r;
+      return (y < 0.f) ? -r : r;
+    }
+
+  }
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+// compiled with /arch:AVX2 (-mavx2), called only if the host supports it.
+#include <immintrin.h>
+#include <model/row_kernel.hpp>
+
+
+namespace model {
+  namespace row_kernel {
+
+    namespace {
+
+      inline __m256 poly(__m256 s, __m256 p, float c) noexcept
+      {
+        return _mm256_add_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(c));
+      }
+
+      // see fast_atan2
+      inline __m256 atan2_8(__m256 y, __m256 x) noexcept
+      {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 ax = _mm256_and_ps(x, abs_mask);
+        const __m256 ay = _mm256_and_ps(y, abs_mask);
+        const __m256 mx = _mm256_max_ps(ax, ay);
+        const __m256 mn = _mm256_min_ps(ax, ay);
+        const __m256 z = _mm256_blendv_ps(zero, _mm256_div_ps(mn, mx), _mm256_cmp_ps(mx, zero, _CMP_GT_OQ));
+        const __m256 s = _mm256_mul_ps(z, z);
+        __m256 p = _mm256_set1_ps(atan_c[5]);
+        p = poly(s, p, atan_c[4]);
+        p = poly(s, p, atan_c[3]);
+        p = poly(s, p, atan_c[2]);
+        p = poly(s, p, atan_c[1]);
+        p = poly(s, p, atan_c[0]);
+        __m256 r = _mm256_mul_ps(z, p);
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(half_pi), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(pi), r), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+        return _mm256_blendv_ps(r, _mm256_sub_ps(zero, r), _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+      }
+
+    }
+
+
+    void avx2(const query& q, float* dist2, float* bearing)
+    {
+      const __m256 px = _mm256_set1_ps(q.pos[0]);
+      const __m256 py = _mm256_set1_ps(q.pos[1]);
+      const __m256 pz = _mm256_set1_ps(q.pos[2]);
+      const __m256 hx = _mm256_set1_ps(q.dir[0]);
+      const __m256 hy = _mm256_set1_ps(q.dir[1]);
+      const __m256 hz = _mm256_set1_ps(q.dir[2]);
+      size_t k = 0;
+      for (; k + 8 <= q.n; k += 8) {
+        __m256 ox, oy, oz;
+        if (q.idx) {
+          const __m256i vi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q.idx + k));
+          ox = _mm256_i32gather_ps(q.x, vi, 4);
+          oy = _mm256_i32gather_ps(q.y, vi, 4);
+          oz = _mm256_i32gather_ps(q.z, vi, 4);
+        }
+        else {
+          ox = _mm256_loadu_ps(q.x + k);
+          oy = _mm256_loadu_ps(q.y + k);
+          oz = _mm256_loadu_ps(q.z + k);
+        }
+        ox = _mm256_sub_ps(ox, px);
+        oy = _mm256_sub_ps(oy, py);
+        oz = _mm256_sub_ps(oz, pz);
+        const __m256 dd = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)), _mm256_mul_ps(oz, oz));
+        const __m256 c = _mm256_sub_ps(_mm256_mul_ps(hx, oy), _mm256_mul_ps(hy, ox));
+        const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, ox), _mm256_mul_ps(hy, oy)), _mm256_mul_ps(hz, oz));
+        _mm256_storeu_ps(dist2 + k, dd);
+        _mm256_storeu_ps(bearing + k, atan2_8(c, d));
+      }
+      if (k < q.n) scalar(tail(q, k), dist2 + k, bearing + k);
+    }
+
+  }
+}
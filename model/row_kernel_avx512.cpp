@@ -0,0 +1,76 @@
+// compiled with /arch:AVX512 (-mavx512f), called only if the host supports it.
+#include <immintrin.h>
+#include <model/row_kernel.hpp>
+
+
+namespace model {
+  namespace row_kernel {
+
+    namespace {
+
+      inline __m512 poly(__m512 s, __m512 p, float c) noexcept
+      {
+        return _mm512_add_ps(_mm512_mul_ps(p, s), _mm512_set1_ps(c));
+      }
+
+      // see fast_atan2
+      inline __m512 atan2_16(__m512 y, __m512 x) noexcept
+      {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 ax = _mm512_abs_ps(x);
+        const __m512 ay = _mm512_abs_ps(y);
+        const __m512 mx = _mm512_max_ps(ax, ay);
+        const __m512 mn = _mm512_min_ps(ax, ay);
+        const __m512 z = _mm512_maskz_div_ps(_mm512_cmp_ps_mask(mx, zero, _CMP_GT_OQ), mn, mx);
+        const __m512 s = _mm512_mul_ps(z, z);
+        __m512 p = _mm512_set1_ps(atan_c[5]);
+        p = poly(s, p, atan_c[4]);
+        p = poly(s, p, atan_c[3]);
+        p = poly(s, p, atan_c[2]);
+        p = poly(s, p, atan_c[1]);
+        p = poly(s, p, atan_c[0]);
+        __m512 r = _mm512_mul_ps(z, p);
+        r = _mm512_mask_sub_ps(r, _mm512_cmp_ps_mask(ay, ax, _CMP_GT_OQ), _mm512_set1_ps(half_pi), r);
+        r = _mm512_mask_sub_ps(r, _mm512_cmp_ps_mask(x, zero, _CMP_LT_OQ), _mm512_set1_ps(pi), r);
+        return _mm512_mask_sub_ps(r, _mm512_cmp_ps_mask(y, zero, _CMP_LT_OQ), zero, r);
+      }
+
+    }
+
+
+    void avx512(const query& q, float* dist2, float* bearing)
+    {
+      const __m512 px = _mm512_set1_ps(q.pos[0]);
+      const __m512 py = _mm512_set1_ps(q.pos[1]);
+      const __m512 pz = _mm512_set1_ps(q.pos[2]);
+      const __m512 hx = _mm512_set1_ps(q.dir[0]);
+      const __m512 hy = _mm512_set1_ps(q.dir[1]);
+      const __m512 hz = _mm512_set1_ps(q.dir[2]);
+      size_t k = 0;
+      for (; k + 16 <= q.n; k += 16) {
+        __m512 ox, oy, oz;
+        if (q.idx) {
+          const __m512i vi = _mm512_loadu_si512(q.idx + k);
+          ox = _mm512_i32gather_ps(vi, q.x, 4);
+          oy = _mm512_i32gather_ps(vi, q.y, 4);
+          oz = _mm512_i32gather_ps(vi, q.z, 4);
+        }
+        else {
+          ox = _mm512_loadu_ps(q.x + k);
+          oy = _mm512_loadu_ps(q.y + k);
+          oz = _mm512_loadu_ps(q.z + k);
+        }
+        ox = _mm512_sub_ps(ox, px);
+        oy = _mm512_sub_ps(oy, py);
+        oz = _mm512_sub_ps(oz, pz);
+        const __m512 dd = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ox, ox), _mm512_mul_ps(oy, oy)), _mm512_mul_ps(oz, oz));
+        const __m512 c = _mm512_sub_ps(_mm512_mul_ps(hx, oy), _mm512_mul_ps(hy, ox));
+        const __m512 d = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(hx, ox), _mm512_mul_ps(hy, oy)), _mm512_mul_ps(hz, oz));
+        _mm512_storeu_ps(dist2 + k, dd);
+        _mm512_storeu_ps(bearing + k, atan2_16(c, d));
+      }
+      if (k < q.n) scalar(tail(q, k), dist2 + k, bearing + k);
+    }
+
+  }
+}
@@ -0,0 +1,135 @@
+#ifndef MODEL_SFC_ORDER_HPP_INCLUDED
+#define MODEL_SFC_ORDER_HPP_INCLUDED
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <tbb/tbb.h>
+#include <hrtree/sorting/parallel_radix_sort.hpp>
+#include <model/model.hpp>
+
+
+namespace model {
+
+
+  namespace sfc {
+
+    constexpr std::uint32_t order = 16;
+    constexpr std::uint32_t max_arg = (1u << order) - 1;
+
+    // Hilbert index of (x, y) in [0, 2^16)^2
+    inline std::uint32_t hilbert(std::uint32_t x, std::uint32_t y) noexcept
+    {
+      std::uint32_t d = 0;
+      for (std::uint32_t s = 1u << (order - 1); s > 0; s >>= 1) {
+        const std::uint32_t rx = (x & s) ? 1 : 0;
+        const std::uint32_t ry = (y & s) ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+          if (rx == 1) {
+            x = max_arg - x;
+            y = max_arg - y;
+          }
+          std::swap(x, y);
+        }
+      }
+      return d;
+    }
+
+    // spreads the lower 16 bits of x to the even bits
+    inline std::uint32_t part1by1(std::uint32_t x) noexcept
+    {
+      x &= 0x0000ffff;
+      x = (x | (x << 8)) & 0x00ff00ff;
+      x = (x | (x << 4)) & 0x0f0f0f0f;
+      x = (x | (x << 2)) & 0x33333333;
+      x = (x | (x << 1)) & 0x55555555;
+      return x;
+    }
+
+    // Morton (Z-order) index of (x, y) in [0, 2^16)^2
+    inline std::uint32_t morton(std::uint32_t x, std::uint32_t y) noexcept
+    {
+      return part1by1(x) | (part1by1(y) << 1);
+    }
+
+  }
+
+
+  // orders agents along a space-filling curve over the xy-plane.
+  // agents close in space end up close in memory.
+  class sfc_order
+  {
+  public:
+    enum class Curve {
+      Hilbert,
+      Morton
+    };
+
+    // returns permutation perm: new index k holds old index perm[k]
+    template <typename Pop>
+    const std::vector<unsigned>& sort(const Pop& pop, Curve curve)
+    {
+      const auto n = pop.size();
+      keys_.resize(n);
+      buf_.resize(n);
+      perm_.resize(n);
+      if (n == 0) return perm_;
+      const auto bb = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n), empty_bbox(), [&](const auto& r, glm::vec4 bb) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          bb = merge(bb, glm::vec4(pop[i].pos.x, pop[i].pos.y, pop[i].pos.x, pop[i].pos.y));
+        }
+        return bb;
+      }, &sfc_order::merge);
+      // same scale in x and y
+      const auto ext = std::max(std::max(bb.z - bb.x, bb.w - bb.y), std::numeric_limits<float>::min());
+      const auto scale = static_cast<float>(sfc::max_arg) / ext;
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const auto& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) {
+          const auto x = std::min(static_cast<std::uint32_t>((pop[i].pos.x - bb.x) * scale), sfc::max_arg);
+          const auto y = std::min(static_cast<std::uint32_t>((pop[i].pos.y - bb.y) * scale), sfc::max_arg);
+          const auto key = (curve == Curve::Hilbert) ? sfc::hilbert(x, y) : sfc::morton(x, y);
+          keys_[i] = { key, static_cast<unsigned>(i) };
+        }
+      });
+      const auto swapped = hrtree::parallel_radix_sort(keys_.begin(), keys_.end(), buf_.begin(), key_converter{});
+      const auto& sorted = swapped ? buf_ : keys_;
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, n), [&](const auto& r) {
+        for (size_t i = r.begin(); i < r.end(); ++i) perm_[i] = sorted[i].idx;
+      });
+      return perm_;
+    }
+
+  private:
+    struct entry
+    {
+      std::uint32_t key;
+      unsigned idx;
+    };
+
+    struct key_converter
+    {
+      static const int key_bytes = sizeof(std::uint32_t);
+      const std::uint8_t* operator()(const entry& x) const { return (const std::uint8_t*)&x.key; }
+    };
+
+    static glm::vec4 empty_bbox() noexcept
+    {
+      const auto fmax = std::numeric_limits<float>::max();
+      return glm::vec4(fmax, fmax, -fmax, -fmax);
+    }
+
+    static glm::vec4 merge(const glm::vec4& a, const glm::vec4& b) noexcept
+    {
+      return glm::vec4(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w));
+    }
+
+    std::vector<entry> keys_;
+    std::vector<entry> buf_;
+    std::vector<unsigned> perm_;
+  };
+
+}
+
+#endif
@@ -1,6 +1,9 @@
 #include <atomic>
+#include <limits>
+#include <numeric>
 #include <tbb/tbb.h>
 #include <hrtree/sorting/radix_sort.hpp>
+#include <hrtree/sorting/insertion_sort.hpp>
 #include <libs/rndutils.hpp>
 #include <agents/agents.hpp>
 #include <model/simulation.hpp>
@@ -10,9 +13,8 @@
 namespace model {
 
 
-  thread_local rndutils::default_engine reng = rndutils::make_random_engine<>();
+  thread_local rng_engine reng = rng_engine(rndutils::make_random_engine<>());
  
-  float Simulation::dt_;
 
   namespace {
 
@@ -20,40 +22,71 @@ namespace model {
 
 
     template <size_t S>
-    void set_snapshot(Simulation* sim, species_pop& pop, const species_snapshots& s)
+    void set_snapshot(Simulation* sim, species_pop& pop, state_array& sa, const species_snapshots& s)
     {
       const auto& ss = std::get<S>(s);
+      auto& pops = std::get<S>(pop);
       if (!ss.empty()) {
-        auto& pops = std::get<S>(pop);
         if (pops.size() != ss.size()) throw std::runtime_error("snapshot mismatch");
-        for (size_t i = 0; i < pops.size(); ++i) {
-          pops[i].snapshot(sim, i, ss[i]);
+        for (size_t id = 0; id < pops.size(); ++id) {
+          const auto i = sa[S].index[id];
+          pops[i].snapshot(sim, i, ss[id]);
         }
       }
-      set_snapshot<S + 1>(sim, pop, s);
+      sa[S].kin.store(pops);
+      set_snapshot<S + 1>(sim, pop, sa, s);
     }
 
     template <>
-    void set_snapshot<model::n_species>(Simulation* sim, species_pop&, const species_snapshots&)
+    void set_snapshot<model::n_species>(Simulation* sim, species_pop&, state_array&, const species_snapshots&)
     {}
 
 
+    // snapshots are in external id order
     template <size_t S>
-    void get_snapshot(const Simulation* sim, const species_pop& pop, species_snapshots& s)
+    void get_snapshot(const Simulation* sim, const species_pop& pop, const state_array& sa, species_snapshots& s)
     {
       auto& ss = std::get<S>(s);
       auto& pops = std::get<S>(pop);
-      for (size_t i = 0; i < pops.size(); ++i) {
+      for (size_t id = 0; id < pops.size(); ++id) {
+        const auto i = sa[S].index[id];
         ss.push_back(pops[i].snapshot(sim, i));
       }
-      get_snapshot<S + 1>(sim, pop, s);
+      get_snapshot<S + 1>(sim, pop, sa, s);
     }
 
     template <>
-    void get_snapshot<model::n_species>(const Simulation* sim, const species_pop&, species_snapshots&)
+    void get_snapshot<model::n_species>(const Simulation* sim, const species_pop&, const state_array&, species_snapshots&)
     {}
 
 
+    // largest 'topo' requested anywhere in the species config
+    size_t max_topo(const json& J)
+    {
+      size_t topo = 0;
+      if (J.is_object() || J.is_array()) {
+        for (auto it = J.cbegin(); it != J.cend(); ++it) {
+          if (J.is_object() && it.key() == "topo" && it->is_number()) {
+            topo = std::max(topo, it->get<size_t>());
+          }
+          topo = std::max(topo, max_topo(*it));
+        }
+      }
+      return topo;
+    }
+
+
+    // active set from the update times
+    template <typename State>
+    void collect_active(State& st)
+    {
+      st.active.clear();
+      for (unsigned i = 0; i < st.update_times.size(); ++i) {
+        if (st.update_times[i] != static_cast<tick_t>(-1)) st.active.push_back(i);
+      }
+    }
+
+
     template <size_t I>
     struct init_simulation_impl
     {
@@ -63,15 +96,21 @@ namespace model {
         const auto& ji = J[agent_type::name()];
         const size_t N = ji["N"];
         auto& popi = std::get<I>(pop);
+        popi.reserve(N);      // agents may refer to agent 0 while constructed
         for (size_t i = 0; i < N; ++i) {
-          popi.emplace_back(i, ji);
+          popi.emplace_back(i, ji, sim);
         }
         sa[I].update_times.resize(N);
-        auto ut_dist = std::uniform_int_distribution<tick_t>(0, static_cast<tick_t>(1.0 / Simulation::dt()));
+        sa[I].coherence.resize(N);
+        sa[I].id.resize(N);
+        std::iota(sa[I].id.begin(), sa[I].id.end(), 0u);
+        sa[I].index = sa[I].id;
+        auto ut_dist = std::uniform_int_distribution<tick_t>(0, static_cast<tick_t>(1.0 / sim.dt()));
         for (auto& ut : sa[I].update_times) {
           ut = ut_dist(reng);
         }
-        apply_cross<0>(J, sa);
+        collect_active(sa[I]);
+        apply_cross<0>(J, ji, sa, sim);
         init_simulation_impl<I + 1>::apply(J, pop, sa, sim);
         for (size_t i = 0; i < N; ++i) {
           popi[i].initialize(i, sim, ji);
@@ -79,21 +118,31 @@ namespace model {
         // initial condition
         species_snapshots ss;
         std::get<I>(ss) = agent_type::init_pop(sim, ji);
-        set_snapshot<I>(&sim, pop, ss );
+        set_snapshot<I>(&sim, pop, sa, ss);
+        if (ji["InitCondit"]["type"] == "dead") {
+          // inactive until activated
+          for (size_t i = 0; i < N; ++i) sim.set_active<std::integral_constant<size_t, I>>(i, false);
+        }
       }
 
       template <size_t K>
-      static void apply_cross(const json& J, state_array& sa)
+      static void apply_cross(const json& J, const json& ji, state_array& sa, const Simulation& sim)
       {
         using agent_type = typename std::tuple_element_t<K, species_pop>::value_type;
         const auto& jk = J[agent_type::name()];
         const size_t N = jk["N"];
-        sa[I].SNI[K].resize(sa[I].size() * N);
-        apply_cross<K + 1>(J, sa);
+        const auto& ns = sim.neighbor_search();
+        const size_t self = (I == K) ? 1 : 0;
+        sa[I].stride[K] = ns.bounded ? std::min(N, std::max(size_t(1), max_topo(ji)) + ns.margin + self) : N;
+        if (!has_neighbors<I, K> || (I != K && ns.nearest_only)) sa[I].stride[K] = 0;
+        sa[I].SNI[K].resize(sa[I].size() * sa[I].stride[K]);
+        sa[I].RNI[K].resize(sa[I].size() * sa[I].stride[K]);
+        sa[I].NN[K].assign(sa[I].size(), 0);
+        apply_cross<K + 1>(J, ji, sa, sim);
       }
 
       template <>
-      static void apply_cross<n_species>(const json&, state_array&) {}
+      static void apply_cross<n_species>(const json&, const json&, state_array&, const Simulation&) {}
     };
 
 
@@ -129,46 +178,227 @@ namespace model {
     private:
       template <size_t J>
       static void apply_(Simulation* sim, size_t idx, state_array& sa)
+      {
+        if constexpr (has_neighbors<I, J>) {
+          if (I == J && sim->neighbor_search().coherent) coherent_row(sim, idx, sa);
+          else if (sa[I].stride[J]) base_row<J>(sim, idx, sa);
+        }
+        apply_<J + 1>(sim, idx, sa);
+      }
+
+      // returns lower bound of the distance to any agent not in the row
+      template <size_t J>
+      static float base_row(Simulation* sim, size_t idx, state_array& sa)
+      {
+        if (sim->neighbor_search().backend == neighbor_search_t::Backend::Grid) {
+          return grid_row<J>(sim, idx, sa);
+        }
+        return brute_row<J>(sim, idx, sa);
+      }
+
+      // completes row[0, n) of species J from {dist2, idx}.
+      // the bearings (and dist2 if set_dist2) come from the row kernel
+      // instead of agent_type::bearing_angl.
+      template <size_t J>
+      static void complete_row(const Simulation* sim, const vec3& pos, const vec3& dir, neighbor_info* row, size_t n, bool set_dist2)
+      {
+        thread_local std::vector<unsigned> ids;
+        thread_local std::vector<float> dd, ba;
+        ids.resize(n);
+        dd.resize(n);
+        ba.resize(n);
+        for (size_t k = 0; k < n; ++k) ids[k] = row[k].idx;
+        const auto& kin = sim->kin<std::integral_constant<size_t, J>>();
+        const auto q = row_kernel::query{ { pos.x, pos.y, pos.z }, { dir.x, dir.y, dir.z }, kin.x(), kin.y(), kin.z(), ids.data(), n };
+        sim->row_kernel()(q, dd.data(), ba.data());
+        for (size_t k = 0; k < n; ++k) {
+          if (set_dist2) row[k].dist2 = dd[k];
+          row[k].bangl = ba[k];
+        }
+      }
+
+      // reference implementation: complete, sorted neighborhood
+      // bounded: the nearest K selected from the complete neighborhood
+      template <size_t J>
+      static float brute_row(Simulation* sim, size_t idx, state_array& sa)
       {
         using agent_type = typename std::tuple_element_t<I, species_pop>::value_type;
-        auto& SNI = sa[I].SNI[J];
-        const auto& popi = sim->pop<std::integral_constant<size_t, I>>();
-        const auto& popj = sim->pop<std::integral_constant<size_t, J>>();
-        const auto& uti = sa[I].update_times;
-        const auto& utj = sa[J].update_times;
-        auto pos = popi[idx].pos;
-        auto dir = popi[idx].dir;
-        //auto cur_state = popi[idx].get_current_state();
-        //auto is_escaping = false;
-        //tick_t time_left = 0;
-        //if (!(sim->esc_states_.empty())) {
-        //    if (std::find(sim->esc_states_.begin(), sim->esc_states_.end(), cur_state) != sim->esc_states_.end())
-        //    {
-        //        is_escaping = true;
-        //        time_left = popi[idx].state_timer;
-        //    }
-        //}
-        
-        auto first = SNI.begin() + (popj.size() * idx);
+        const auto& kini = sa[I].kin;
+        const auto& kinj = sa[J].kin;
+        const auto stride = sa[I].stride[J];
+        const auto pos = kini.pos(idx);
+        const auto dir = kini.dir(idx);
+        const auto& active = sa[J].active;
+        auto first = sa[I].SNI[J].begin() + (stride * idx);
+        auto raw = sa[I].RNI[J].begin() + (stride * idx);
+        if (stride < active.size()) {
+          thread_local std::vector<neighbor_info> buf;
+          thread_local std::vector<float> dd;
+          buf.resize(active.size());
+          if (active.size() == kinj.size()) {
+            // all active: stream the positions
+            dd.resize(active.size());
+            kinj.distance2(pos, dd.data());
+            for (size_t k = 0; k < active.size(); ++k) {
+              buf[k].dist2 = dd[k];
+              buf[k].idx = static_cast<unsigned>(k);
+            }
+          }
+          else {
+            for (size_t k = 0; k < active.size(); ++k) {
+              buf[k].dist2 = agent_type::distance2(pos, kinj.pos(active[k]));
+              buf[k].idx = active[k];
+            }
+          }
+          const auto by_dist = [](const auto& a, const auto& b) { return a.dist2 < b.dist2; };
+          std::nth_element(buf.begin(), buf.begin() + stride, buf.end(), by_dist);
+          std::sort(buf.begin(), buf.begin() + stride, by_dist);
+          std::copy(buf.cbegin(), buf.cbegin() + stride, first);
+          complete_row<J>(sim, pos, dir, &*first, stride, false);
+          std::copy(first, first + stride, raw);
+          std::sort(raw, raw + stride, [](const auto& a, const auto& b) { return a.idx < b.idx; });
+          sa[I].NN[J][idx] = static_cast<unsigned>(stride);
+          return std::sqrt(buf[stride].dist2);
+        }
         auto it = first;
-        for (unsigned j = 0; j < popj.size(); ++j, ++it) {
-           const auto jstate = popj[j].get_current_state();
-          *it = { agent_type::distance2(pos, popj[j].pos), 
-              j, 
-              agent_type::bearing_angl(dir, pos, popj[j].pos),
-              (std::find(sim->esc_states_.begin(), sim->esc_states_.end(), jstate) != sim->esc_states_.end()),
-              jstate,
-              popj[j].state_timer
-          };
+        for (const auto j : active) {
+          (it++)->idx = j;
         }
-        sa[I].RNI[J] = SNI;     // pre-sorted
+        complete_row<J>(sim, pos, dir, &*first, active.size(), true);
+        std::copy(first, it, raw);     // pre-sorted
+        sa[I].NN[J][idx] = static_cast<unsigned>(active.size());
 #ifndef NDEBUG
         // visual studio debug build crawls trough radix sort
         std::sort(first, it, [](const auto& a, const auto& b) { return a.dist2 < b.dist2; });
 #else
         hrtree::inplace_radix_sort(first, it, radix_sort_converter{});
 #endif
-        apply_<J + 1>(sim, idx, sa);
+        return std::numeric_limits<float>::infinity();
+      }
+
+      // nearest neighbors from the cell-list of species J, 'self' first
+      template <size_t J>
+      static float grid_row(Simulation* sim, size_t idx, state_array& sa)
+      {
+        thread_local std::vector<neighbor_info> buf;
+        const auto& ns = sim->neighbor_search();
+        const auto& kini = sa[I].kin;
+        const auto stride = sa[I].stride[J];
+        const auto pos = kini.pos(idx);
+        const auto dir = kini.dir(idx);
+        const size_t self = (I == J) ? 1 : 0;
+        auto first = sa[I].SNI[J].begin() + (stride * idx);
+        auto it = first;
+        if constexpr (I == J) {
+          *it++ = neighbor_info{ 0.f, static_cast<unsigned>(idx) };
+        }
+        const auto topo = std::min(ns.bounded ? stride : ns.topo, stride - self);
+        const auto maxdist2 = (I == J) ? ns.maxdist2 : std::numeric_limits<float>::infinity();
+        // one more for the guard distance (coherent)
+        const auto extra = (I == J && ns.coherent) ? 1 : 0;
+        auto n = sa[J].grid.knn(pos, topo + extra, maxdist2, buf, [idx](unsigned j) { return I == J && j == idx; });
+        auto guard = std::sqrt(maxdist2);
+        if (n > topo) {
+          guard = std::sqrt(buf[topo].dist2);
+          n = topo;
+        }
+        it = std::copy(buf.cbegin(), buf.cbegin() + n, it);
+        complete_row<J>(sim, pos, dir, &*first, std::distance(first, it), false);
+        std::copy(first, it, sa[I].RNI[J].begin() + (stride * idx));
+        sa[I].NN[J][idx] = static_cast<unsigned>(std::distance(first, it));
+        return guard;
+      }
+
+      // same-species neighborhood from the last one, falls back to base_row
+      static void coherent_row(Simulation* sim, size_t idx, state_array& sa)
+      {
+        auto& ci = sa[I].coherence[idx];
+        const auto incremental = incremental_row(sim, idx, sa, ci);
+        if (!incremental) {
+          ci.guard = base_row<I>(sim, idx, sa);
+        }
+        ci.pos = sa[I].kin.pos(idx);
+        ci.drift = sa[I].motion.drift();
+        ci.spread = sa[I].motion.spread();
+        sa[I].coherent.count(incremental);
+      }
+
+      // candidates: the last neighborhood and the neighborhoods of its nearest
+      // K - margin, re-sorted by insertion sort.
+      // fails if any agent outside the candidate set could be closer than
+      // the (K - margin)th candidate.
+      static bool incremental_row(Simulation* sim, size_t idx, state_array& sa, coherent_info& ci)
+      {
+        if (ci.guard < 0.f) return false;
+        using agent_type = typename std::tuple_element_t<I, species_pop>::value_type;
+        thread_local std::vector<neighbor_info> buf;
+        thread_local std::vector<unsigned> stamp;     // visited marks
+        thread_local unsigned query = 0;
+        const auto& ns = sim->neighbor_search();
+        const auto& kin = sa[I].kin;
+        const auto& mb = sa[I].motion;
+        const auto pos = kin.pos(idx);
+        const auto dir = kin.dir(idx);
+        // lower bound of the distance to any agent not seen by the last update
+        const auto guard = ci.guard - static_cast<float>(glm::length(glm::dvec3(pos - ci.pos) - (mb.drift() - ci.drift)) + (mb.spread() - ci.spread));
+        if (guard <= 0.f) return false;
+        const auto inf = std::numeric_limits<float>::infinity();
+        const auto maxdist2 = (ns.backend == neighbor_search_t::Backend::Grid) ? ns.maxdist2 : inf;
+        const auto stride = sa[I].stride[I];
+        const auto keep = stride - 1;     // w/o 'self'
+        const auto exact = (keep > ns.margin) ? keep - ns.margin : keep;
+        const auto row = sa[I].SNI[I].cbegin() + (stride * idx);
+        const auto nrow = sa[I].NN[I][idx];
+        if (stamp.size() != kin.size()) {
+          stamp.assign(kin.size(), 0);
+          query = 0;
+        }
+        if (++query == 0) {
+          std::fill(stamp.begin(), stamp.end(), 0);
+          query = 1;
+        }
+        stamp[idx] = query;
+        buf.clear();
+        auto dropped2 = inf;    // nearest candidate not kept
+        auto worst2 = inf;
+        const auto add = [&](unsigned j) {
+          if (stamp[j] != query) {
+            stamp[j] = query;
+            const auto dd = agent_type::distance2(pos, kin.pos(j));
+            if (dd < worst2 && dd <= maxdist2) buf.push_back(neighbor_info{ dd, j });
+            else dropped2 = std::min(dropped2, dd);
+          }
+        };
+        const auto by_dist = [](const neighbor_info& a, const neighbor_info& b) { return a.dist2 < b.dist2; };
+        for (size_t k = 1; k < nrow; ++k) add(row[k].idx);
+        hrtree::insertion_sort(buf.begin(), buf.end(), by_dist);    // nearly sorted
+        if (keep > 0 && buf.size() >= keep) worst2 = buf[keep - 1].dist2;
+        // rows of other agents are rewritten concurrently; we take their
+        // indices from the snapshot of the last tick.
+        for (size_t k = 1; k < std::min(size_t(nrow), exact + 1); ++k) {
+          const auto j = row[k].idx;
+          const auto rowj = sa[I].prev_idx.cbegin() + (stride * j);
+          const auto nrowj = std::min(size_t(sa[I].prev_nn[j]), stride);
+          for (size_t q = 1; q < nrowj; ++q) add(rowj[q]);
+        }
+        hrtree::insertion_sort(buf.begin(), buf.end(), by_dist);
+        if (buf.size() > keep) {
+          dropped2 = std::min(dropped2, buf[keep].dist2);
+          buf.resize(keep);
+        }
+        if (exact > 0 && guard * guard < maxdist2) {
+          // otherwise every agent within maxdist is a candidate
+          if (buf.size() < exact || buf[exact - 1].dist2 > guard * guard) return false;
+        }
+        auto first = sa[I].SNI[I].begin() + (stride * idx);
+        auto it = first;
+        *it++ = neighbor_info{ 0.f, static_cast<unsigned>(idx) };
+        it = std::copy(buf.cbegin(), buf.cend(), it);
+        complete_row<I>(sim, pos, dir, &*first, std::distance(first, it), false);
+        std::copy(first, it, sa[I].RNI[I].begin() + (stride * idx));
+        sa[I].NN[I][idx] = static_cast<unsigned>(std::distance(first, it));
+        ci.guard = std::min(guard, std::sqrt(dropped2));
+        return true;
       }
 
       template <>
@@ -178,72 +408,277 @@ namespace model {
 
 
     template <size_t S>
-    void update_species(Simulation* sim, species_pop& pop, state_array& sa)
+    void build_neighbor_grids(state_array& sa)
     {
-      auto& pops = std::get<S>(pop);
-      auto& uts = std::get<S>(sa).update_times;
-      const auto T = sim->tick();
-      const auto forced_ni_update = sim->forced_neighbor_info_update();
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, pops.size()), [&, sim, T](auto r) {
-        for (size_t i = r.begin(); i < r.end(); ++i) {
-          const auto update = uts[i] <= T;
-          if (update || forced_ni_update) update_neighbor_info<S>::apply(sim, i, sa);
-          if (update) uts[i] = pops[i].update(i, T, *sim);
+      std::get<S>(sa).grid.build(std::get<S>(sa).kin, std::get<S>(sa).active);
+      build_neighbor_grids<S + 1>(sa);
+    }
+
+    template <>
+    void build_neighbor_grids<model::n_species>(state_array&)
+    {}
+
+
+    template <size_t S>
+    void track_motion(state_array& sa)
+    {
+      std::get<S>(sa).motion.track(std::get<S>(sa).kin, std::get<S>(sa).active);
+      track_motion<S + 1>(sa);
+    }
+
+    template <>
+    void track_motion<model::n_species>(state_array&)
+    {}
+
+
+    // same-species neighbor indices as of the last tick, see incremental_row
+    template <size_t S>
+    void snapshot_neighbors(state_array& sa)
+    {
+      auto& st = std::get<S>(sa);
+      st.prev_idx.resize(st.SNI[S].size());
+      st.prev_nn = st.NN[S];
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, st.SNI[S].size()), [&](const auto& r) {
+        for (auto k = r.begin(); k < r.end(); ++k) st.prev_idx[k] = st.SNI[S][k].idx;
+      });
+      snapshot_neighbors<S + 1>(sa);
+    }
+
+    template <>
+    void snapshot_neighbors<model::n_species>(state_array&)
+    {}
+
+
+    template <size_t S>
+    void reset_coherence(state_array& sa)
+    {
+      for (auto& ci : std::get<S>(sa).coherence) ci.guard = -1.f;
+      std::get<S>(sa).motion.reset();
+      reset_coherence<S + 1>(sa);
+    }
+
+    template <>
+    void reset_coherence<model::n_species>(state_array&)
+    {}
+
+
+    // v'[k] = v[perm[k]]
+    template <typename T>
+    void permute(std::vector<T>& v, const std::vector<unsigned>& perm)
+    {
+      if (v.size() != perm.size()) return;
+      std::vector<T> tmp;
+      tmp.reserve(v.size());
+      for (const auto i : perm) tmp.push_back(std::move(v[i]));
+      v.swap(tmp);
+    }
+
+
+    // row-wise permute(), rows of length stride
+    template <typename T>
+    void permute_rows(std::vector<T>& v, size_t stride, const std::vector<unsigned>& perm)
+    {
+      if (v.size() != stride * perm.size()) return;
+      std::vector<T> tmp(v.size());
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, perm.size()), [&](const auto& r) {
+        for (size_t k = r.begin(); k < r.end(); ++k) {
+          std::copy_n(v.cbegin() + stride * perm[k], stride, tmp.begin() + stride * k);
         }
       });
-      update_species<S + 1>(sim, pop, sa);
+      v.swap(tmp);
+    }
+
+
+    // sorts the agents of species S along a space-filling curve.
+    // everything indexed by agent index is permuted, neighbor indices are
+    // remapped. external ids stay put.
+    template <size_t S>
+    void reorder_species(species_pop& pop, state_array& sa, sfc_order::Curve curve)
+    {
+      auto& pops = std::get<S>(pop);
+      auto& st = std::get<S>(sa);
+      const auto& perm = st.order.sort(pops, curve);
+      std::vector<unsigned> inv(perm.size());
+      for (unsigned k = 0; k < perm.size(); ++k) inv[perm[k]] = k;
+      permute(pops, perm);
+      st.kin.store(pops);
+      permute(st.update_times, perm);
+      collect_active(st);
+      st.schedule.invalidate();
+      permute(st.stress, perm);
+      permute(st.coherence, perm);
+      permute(st.id, perm);
+      for (unsigned k = 0; k < st.id.size(); ++k) st.index[st.id[k]] = k;
+      st.motion.permute(perm);
+      st.flock_tracker.permute(perm);
+      st.flock_hierarchy.permute(perm);
+      for (size_t J = 0; J < n_species; ++J) {
+        permute_rows(st.SNI[J], st.stride[J], perm);
+        permute_rows(st.RNI[J], st.stride[J], perm);
+        permute(st.NN[J], perm);
+      }
+      // neighbor indices into species S
+      for (auto& si : sa) {
+        for (auto* ni : { &si.SNI[S], &si.RNI[S] }) {
+          tbb::parallel_for(tbb::blocked_range<size_t>(0, ni->size()), [&](const auto& r) {
+            for (size_t i = r.begin(); i < r.end(); ++i) {
+              auto& e = (*ni)[i];
+              if (e.idx < inv.size()) e.idx = inv[e.idx];
+            }
+          });
+        }
+      }
+      reorder_species<S + 1>(pop, sa, curve);
     }
 
     template <>
-    void update_species<model::n_species>(Simulation*, species_pop&, state_array&)
+    void reorder_species<model::n_species>(species_pop&, state_array&, sfc_order::Curve)
     {}
 
 
+    // rows are part of the checkpoint if bounded, they are recomputed
+    // before any agent update otherwise.
+    // mask: bit s: species s is part of the archive.
     template <size_t S>
-    void integrate_species(Simulation* sim, species_pop& pop, state_array& sa)
+    void checkpoint_species(archive& ar, species_pop& pop, state_array& sa, const neighbor_search_t& ns, unsigned mask = ~0u)
+    {
+      if (!((mask >> S) & 1)) return checkpoint_species<S + 1>(ar, pop, sa, ns, mask);
+      auto& pops = std::get<S>(pop);
+      auto& st = std::get<S>(sa);
+      ar.expect(static_cast<std::uint64_t>(pops.size()), "population size");
+      ar(st.update_times, st.id, st.index, st.stress, st.flock_tracker, st.flock_hierarchy);
+      for (auto& a : pops) a.checkpoint(ar);
+      if (ns.bounded) {
+        ar(st.SNI, st.RNI, st.NN, st.coherence, st.motion);
+      }
+      if (ar.loading()) {
+        collect_active(st);
+        st.kin.store(pops);
+        st.schedule.invalidate();
+        st.grid.clear();
+        if (!ns.bounded) {
+          for (auto& nn : st.NN) std::fill(nn.begin(), nn.end(), 0);
+        }
+      }
+      checkpoint_species<S + 1>(ar, pop, sa, ns, mask);
+    }
+
+    template <>
+    void checkpoint_species<model::n_species>(archive&, species_pop&, state_array&, const neighbor_search_t&, unsigned)
+    {}
+
+
+    // agents and update times as initialized at tick 0, re-entered at T
+    template <size_t S>
+    void restart_species(Simulation& sim, species_pop& pop, state_array& sa, const json& ji, tick_t T)
+    {
+      auto& pops = std::get<S>(pop);
+      auto& st = std::get<S>(sa);
+      for (auto& ut : st.update_times) {
+        if (ut != static_cast<tick_t>(-1)) ut += T;
+      }
+      for (size_t i = 0; i < pops.size(); ++i) {
+        pops[i].initialize(i, sim, ji);
+      }
+      st.kin.store(pops);
+    }
+
+
+    template <size_t S>
+    void update_species(Simulation* sim, species_pop& pop, state_array& sa)
     {
       auto& pops = std::get<S>(pop);
       auto& uts = std::get<S>(sa).update_times;
+      const auto& active = std::get<S>(sa).active;
+      auto& schedule = std::get<S>(sa).schedule;
       const auto T = sim->tick();
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, pops.size()), [&, sim, T](auto r) {
-        for (size_t i = r.begin(); i < r.end(); ++i) {
-          if (uts[i] != static_cast<tick_t>(-1)) {
-            pops[i].integrate(T, *sim);
+      const auto& due = schedule.collect(uts, active, T);
+      if (sim->forced_neighbor_info_update()) {
+        // full pass: neighbor info for everybody
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, active.size()), [&, sim, T](auto r) {
+          for (size_t k = r.begin(); k < r.end(); ++k) {
+            const auto i = active[k];
+            const auto _ = sim->rng_stream(S, sa[S].id[i]);
+            update_neighbor_info<S>::apply(sim, i, sa);
+            if (uts[i] <= T) uts[i] = pops[i].update(i, T, *sim);
           }
-        }
-      });
-      integrate_species<S + 1>(sim, pop, sa);
-      std::get<S>(sa).flock_tracker.track();
+        });
+      }
+      else {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, due.size()), [&, sim, T](auto r) {
+          for (size_t k = r.begin(); k < r.end(); ++k) {
+            const auto i = due[k];
+            const auto _ = sim->rng_stream(S, sa[S].id[i]);
+            update_neighbor_info<S>::apply(sim, i, sa);
+            uts[i] = pops[i].update(i, T, *sim);
+          }
+        });
+      }
+      schedule.reschedule(uts, T);
     }
 
 
-    template <>
-    void integrate_species<model::n_species>(Simulation*, species_pop&, state_array&)
-    {}
+    template <size_t S>
+    void integrate_species(Simulation* sim, species_pop& pop, state_array& sa)
+    {
+      auto& pops = std::get<S>(pop);
+      auto& kin = std::get<S>(sa).kin;
+      const auto& active = std::get<S>(sa).active;
+      const auto T = sim->tick();
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, active.size()), [&, sim, T](auto r) {
+        for (size_t k = r.begin(); k < r.end(); ++k) {
+          const auto i = active[k];
+          pops[i].integrate(T, *sim);
+          kin.store(i, pops[i]);
+        }
+      });
+      std::get<S>(sa).flock_tracker.track(sim->dt());
+      std::get<S>(sa).flock_hierarchy.track(sim->dt());
+    }
 
     template <size_t S>
     void integrate_species_flock(Simulation* sim, species_pop& pop, state_array& sa, float fdd)
     {
       auto& pops = std::get<S>(pop);
-      auto& uts = std::get<S>(sa).update_times;
+      const auto& active = std::get<S>(sa).active;
       auto& fts = std::get<S>(sa).flock_tracker;
-      fts.prepare(pops.size());
+      auto& kin = std::get<S>(sa).kin;
+      fts.prepare(pops.size(), active.size());
       const auto T = sim->tick();
-      tbb::parallel_for(tbb::blocked_range<size_t>(0, pops.size()), [&, sim, T](auto r) {
-        for (size_t i = r.begin(); i < r.end(); ++i) {
-          if (uts[i] != static_cast<tick_t>(-1)) {
-            pops[i].integrate(T, *sim);
-            fts.feed(pops[i], i);
-          }
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, active.size()), [&, sim, T](auto r) {
+        for (size_t k = r.begin(); k < r.end(); ++k) {
+          const auto i = active[k];
+          pops[i].integrate(T, *sim);
+          kin.store(i, pops[i]);
+          fts.feed(k, pops[i], i);
         }
       });
-      integrate_species_flock<S + 1>(sim, pop, sa, fdd);
-      fts.cluster(fdd);
+      fts.cluster(fdd, T);
+      std::get<S>(sa).flock_hierarchy.build(kin, active, T);
     }
 
-    template <>
-    void integrate_species_flock<model::n_species>(Simulation*, species_pop&, state_array&, float)
-    {}
+
+    // runs phase(std::integral_constant<size_t, S>{}) for every species S,
+    // as concurrent tasks if 'concurrent', in species order otherwise.
+    // the phases must not touch each other's species state.
+    template <typename Phase, size_t... S>
+    void for_species(bool concurrent, Phase&& phase, std::index_sequence<S...>)
+    {
+      if (concurrent) {
+        tbb::task_group tg;
+        (tg.run([&phase] { phase(std::integral_constant<size_t, S>{}); }), ...);
+        tg.wait();
+      }
+      else {
+        (phase(std::integral_constant<size_t, S>{}), ...);
+      }
+    }
+
+    template <typename Phase>
+    void for_species(bool concurrent, Phase&& phase)
+    {
+      for_species(concurrent, std::forward<Phase>(phase), std::make_index_sequence<n_species>{});
+    }
 
   }
   
@@ -264,9 +699,81 @@ namespace model {
     flock_dd_ = flock_threshold * flock_threshold;
     flock_update_ = 0;
     flock_interval_ = time2tick(J["Simulation"]["flockDetection"]["interval"]);
+    if (J["Simulation"]["flockDetection"].contains("hierarchy")) {
+      const std::vector<float> thresholds = J["Simulation"]["flockDetection"]["hierarchy"];
+      for (auto& s : state_) s.flock_hierarchy = model::flock_hierarchy(thresholds);
+    }
     const std::vector<int> esc_states = J["Simulation"]["esc_states"];
     std::for_each(esc_states.begin(), esc_states.end(), [&](const auto& st) { esc_states_.push_back(st); });
+    for (const auto st : esc_states_) {
+      if (st >= 0 && st < 64) esc_mask_ |= std::uint64_t(1) << st;
+    }
+    ns_.isa = row_kernel::host_isa();
+    if (J["Simulation"].contains("neighborSearch")) {
+      const auto& jns = J["Simulation"]["neighborSearch"];
+      const std::string backend = jns["backend"];
+      if (backend == "grid") ns_.backend = neighbor_search_t::Backend::Grid;
+      else if (backend != "brute") throw std::runtime_error("unknown neighbor search backend");
+      ns_.bounded = 0 != int(jns["bounded"]);
+      ns_.margin = jns["margin"];
+      ns_.topo = jns["topo"];
+      const float maxdist = jns["maxdist"];
+      ns_.maxdist2 = maxdist * maxdist;
+      ns_.cell_size = jns["cellSize"];
+      ns_.coherent = jns.contains("coherent") && (0 != int(jns["coherent"]));
+      if (ns_.coherent && !ns_.bounded) {
+        throw std::runtime_error("neighborSearch: 'coherent' requires 'bounded'");
+      }
+      ns_.nearest_only = jns.contains("nearestOnly") && (0 != int(jns["nearestOnly"]));
+      if (jns.contains("kernel")) {
+        const std::string kernel = jns["kernel"];
+        if (kernel == "scalar") ns_.isa = row_kernel::Isa::Scalar;
+        else if (kernel == "avx2") ns_.isa = std::min(ns_.isa, row_kernel::Isa::AVX2);
+        else if (kernel != "auto" && kernel != "avx512") throw std::runtime_error("neighborSearch: unknown kernel");
+      }
+      if (ns_.backend == neighbor_search_t::Backend::Grid && ((!ns_.bounded && ns_.topo == 0) || ns_.cell_size <= 0.f)) {
+        throw std::runtime_error("neighborSearch: 'topo' and 'cellSize' must be positive");
+      }
+      if (ns_.nearest_only && ns_.cell_size <= 0.f) {
+        throw std::runtime_error("neighborSearch: 'nearestOnly' requires positive 'cellSize'");
+      }
+    }
+    row_kernel_ = row_kernel::select(ns_.isa);
+    for (auto& s : state_) s.grid.set_cell_size(ns_.cell_size > 0.f ? ns_.cell_size : 1.f);
+    if (J["Simulation"].contains("reorder")) {
+      const auto& jr = J["Simulation"]["reorder"];
+      reorder_interval_ = time2tick(jr["interval"]);
+      const std::string curve = jr["curve"];
+      if (curve == "morton") reorder_curve_ = sfc_order::Curve::Morton;
+      else if (curve != "hilbert") throw std::runtime_error("reorder: unknown curve");
+    }
+
+    if (J["Simulation"].contains("concurrentSpecies")) {
+      concurrent_species_ = 0 != int(J["Simulation"]["concurrentSpecies"]);
+    }
+    if (J["Simulation"].contains("rng")) {
+      const auto& jr = J["Simulation"]["rng"];
+      const std::string mode = jr["mode"];
+      if (mode == "counter") counter_rng_ = true;
+      else if (mode != "engine") throw std::runtime_error("rng: unknown mode");
+      rng_seed_ = jr.contains("seed") ? uint64_t(jr["seed"]) : reng();
+      if (!counter_rng_ && jr.contains("seed")) {
+        // reproducible on one thread
+        own_engine_ = true;
+        engine_ = rndutils::make_random_engine<>(static_cast<rndutils::default_engine::result_type>(rng_seed_));
+      }
+    }
 
+    if (J["Simulation"].contains("restart")) {
+      for (const std::string name : J["Simulation"]["restart"]) {
+        if (!J.contains(name)) throw std::runtime_error("restart: unknown species " + name);
+        restart_[name] = J[name];
+      }
+    }
+
+    // initialization is serial, one stream
+    const auto _ = rng_stream(n_species, static_cast<size_t>(-1));
+    const auto __ = own_rng();
     init_simulation_state(J, species_, state_, *this);
   }
 
@@ -288,13 +795,34 @@ namespace model {
     notify_observer(observer, PreTick, this);
     {
       std::lock_guard<std::recursive_mutex> _(mutex_);
-      update_species<0>(this, species_, state_);
+      const auto __ = own_rng();
+      if (reorder_interval_ && reorder_update_ == tick_) {
+        reorder_species<0>(species_, state_, reorder_curve_);
+        reorder_update_ += reorder_interval_;
+      }
+      if (ns_.backend == neighbor_search_t::Backend::Grid || ns_.nearest_only) {
+        build_neighbor_grids<0>(state_);
+      }
+      if (active_changed_) {
+        reset_coherence<0>(state_);
+        active_changed_ = false;
+      }
+      if (ns_.coherent) {
+        track_motion<0>(state_);
+        snapshot_neighbors<0>(state_);
+      }
+      // the species update concurrently: agents read other species from
+      // the kinematics mirror or from fields only integration writes.
+      // integration waits for all updates, the flock tracking of a species
+      // only for its own integration.
+      const auto concurrent = concurrent_species_ && std::min<size_t>(tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism), tbb::this_task_arena::max_concurrency()) > 1;
+      for_species(concurrent, [this](auto S) { update_species<decltype(S)::value>(this, species_, state_); });
       if (flock_update_ == tick_) {
-        integrate_species_flock<0>(this, species_, state_, flock_dd_);
+        for_species(concurrent, [this](auto S) { integrate_species_flock<decltype(S)::value>(this, species_, state_, flock_dd_); });
         flock_update_ += flock_interval_;
       }
       else {
-        integrate_species<0>(this, species_, state_);
+        for_species(concurrent, [this](auto S) { integrate_species<decltype(S)::value>(this, species_, state_); });
       }
       ++tick_;
     }
@@ -305,7 +833,8 @@ namespace model {
   void Simulation::set_snapshots(const species_snapshots& ss)
   {
     std::lock_guard<std::recursive_mutex> _(mutex_);
-    set_snapshot<0>(this, species_, ss);
+    set_snapshot<0>(this, species_, state_, ss);
+    reset_coherence<0>(state_);     // agents might have been teleported
   }
 
 
@@ -313,8 +842,97 @@ namespace model {
   {
     std::lock_guard<std::recursive_mutex> _(mutex_);
     species_snapshots res;
-    get_snapshot<0>(this, species_, res);
+    get_snapshot<0>(this, species_, state_, res);
     return res;
   }
 
+
+  std::vector<char> Simulation::checkpoint(Observer* observer) const
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    archive ar(true);
+    const_cast<Simulation*>(this)->checkpoint_io(ar);
+    auto observed = observer != nullptr;
+    ar(observed);
+    if (observer) observer->checkpoint(ar, *this);
+    return ar.release();
+  }
+
+
+  std::vector<char> Simulation::branch_point() const
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    archive ar(false);
+    const_cast<Simulation*>(this)->checkpoint_io(ar);
+    return ar.release();
+  }
+
+
+  void Simulation::restore(const std::vector<char>& buf, Observer* observer)
+  {
+    std::lock_guard<std::recursive_mutex> _(mutex_);
+    archive ar(buf);
+    unsigned restart = 0;
+    for_species(false, [&](auto S) {
+      using agent_type = typename std::tuple_element_t<decltype(S)::value, species_pop>::value_type;
+      if (!ar.parameters() && restart_.contains(agent_type::name())) restart |= 1u << S;
+    });
+    archive initial(false);
+    checkpoint_species<0>(initial, species_, state_, ns_, restart);
+    checkpoint_io(ar);
+    if (ar.parameters()) {
+      auto observed = false;
+      ar(observed);
+      if (observed && observer) observer->checkpoint(ar, *this);
+    }
+    if (restart) {
+      const auto buf0 = initial.release();
+      archive ai(buf0);
+      checkpoint_species<0>(ai, species_, state_, ns_, restart);
+      const auto __ = rng_stream(n_species, static_cast<size_t>(-1));
+      const auto ___ = own_rng();
+      for_species(false, [&](auto S) {
+        using agent_type = typename std::tuple_element_t<decltype(S)::value, species_pop>::value_type;
+        if ((restart >> S) & 1) restart_species<decltype(S)::value>(*this, species_, state_, restart_[agent_type::name()], tick_);
+      });
+      active_changed_ = true;     // agents have been teleported
+    }
+  }
+
+
+  std::vector<std::unique_ptr<Simulation>> Simulation::fork(const std::vector<json>& configs) const
+  {
+    const auto bp = branch_point();
+    std::vector<std::unique_ptr<Simulation>> res(configs.size());
+    tbb::parallel_for(size_t(0), configs.size(), [&](size_t i) {
+      auto J = configs[i];
+      auto* jr = J["Simulation"].contains("rng") ? &J["Simulation"]["rng"] : nullptr;
+      if (jr && jr->contains("seed") && uint64_t((*jr)["seed"]) == rng_seed_) {
+        (*jr)["seed"] = philox::branch_seed(rng_seed_, i);
+      }
+      res[i] = std::make_unique<Simulation>(J);
+      res[i]->restore(bp);
+    });
+    return res;
+  }
+
+
+  // the rng state is the seed (mode counter), the engine of the simulation
+  // (mode engine with seed) or else the calling thread's engine; the engines
+  // continue identically on one thread only.
+  void Simulation::checkpoint_io(archive& ar)
+  {
+    ar.expect(static_cast<std::uint32_t>(n_species), "species count");
+    ar.expect(dt_, "dt");
+    ar.expect(ns_.bounded, "neighborSearch.bounded");
+    ar.expect(ns_.coherent, "neighborSearch.coherent");
+    ar(tick_, flock_update_, reorder_update_, active_changed_);
+    if (ar.parameters()) {
+      ar(counter_rng_, rng_seed_, own_engine_);
+      if (own_engine_) ar(engine_);
+      else ar(reng);
+    }
+    checkpoint_species<0>(ar, species_, state_, ns_);
+  }
+
 }
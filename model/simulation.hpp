@@ -3,17 +3,45 @@
 
 #include <mutex>
 #include <atomic>
+#include <span>
+#include <string>
+#include <cstdint>
+#include <algorithm>
 #include <model/json.hpp>
 #include <model/flock.hpp>
+#include <model/flock_hierarchy.hpp>
+#include <model/kinematics.hpp>
+#include <model/row_kernel.hpp>
+#include <model/neighbor_grid.hpp>
+#include <model/coherent_knn.hpp>
+#include <model/due_schedule.hpp>
+#include <model/sfc_order.hpp>
+#include <model/checkpoint.hpp>
 
 
 namespace model {
 
-  class Simulation
+  // neighbor search settings, config key Simulation.neighborSearch
+  struct neighbor_search_t
   {
-  private:
-    static float dt_;
+    enum class Backend {
+      Brute,      // reference: distance to every agent, full sort
+      Grid        // cell-list, nearest 'topo' within 'maxdist'
+    };
+
+    Backend backend = Backend::Brute;
+    bool bounded = false;     // keep only the nearest K neighbors per species pair
+    bool coherent = false;    // same-species: reuse last neighborhood, backend as fallback (bounded)
+    bool nearest_only = false;  // cross-species: no neighbor matrices, served by Simulation::nearest()
+    size_t margin = 0;        // [1] K = largest configured 'topo' + margin (bounded)
+    size_t topo = 0;          // [1] neighbors served per species pair (Grid, unbounded)
+    float maxdist2 = 0.f;     // [m^2] search radius for same-species neighborhoods (Grid)
+    float cell_size = 0.f;    // [m] (Grid)
+    row_kernel::Isa isa = row_kernel::Isa::Scalar;    // row construction kernel, default: best on host
+  };
 
+  class Simulation
+  {
   public:
     enum Msg {
       Tick = 0,
@@ -30,18 +58,58 @@ namespace model {
     void set_snapshots(const species_snapshots& ss);
     species_snapshots get_snapshots() const;
 
+    // complete state, see model/checkpoint.hpp. the capture is a copy into
+    // memory; the buffer can be written (write_checkpoint) from another thread.
+    // the observer chain adds its own, see Observer::checkpoint.
+    std::vector<char> checkpoint(class Observer* observer = nullptr) const;
+
+    // run state without parameters and rng state: simulations restored from
+    // it continue this one with the parameters and rng stream of their own config.
+    std::vector<char> branch_point() const;
+
+    // continues from a checkpoint or branch point of a simulation with the
+    // same configuration (branch point: same population sizes, dt and
+    // neighbor search). buf is only read, branches may share it.
+    // the observer chain gets its part of a checkpoint back, if both have one.
+    // from a branch point, the species listed in the config key Simulation.restart
+    // start over from their own initial conditions at the branch point's tick.
+    void restore(const std::vector<char>& buf, class Observer* observer = nullptr);
+
+    // one new simulation per config, branched from the current state.
+    // branches seeded like this one get the seed mixed with their index.
+    std::vector<std::unique_ptr<Simulation>> fork(const std::vector<json>& configs) const;
+
     // request forced neighbor info update every tick
     void force_neighbor_info_update(bool required) const { force_ni_update_.fetch_add(required ? +1 : -1); }
     bool forced_neighbor_info_update() const { return force_ni_update_.load(std::memory_order_acquire) > 0; }
 
     void update(class Observer* observer);
+
+    const neighbor_search_t& neighbor_search() const noexcept { return ns_; }
+
+    // routes the draws from model::reng of the calling thread to the stream
+    // of agent 'id' of 'species' at the current tick if the counter based rng
+    // is selected (config key Simulation.rng), until the scope is left.
+    rng_scope rng_stream(size_t species, size_t id) const noexcept
+    {
+      return rng_scope(reng, counter_rng_, rng_seed_, static_cast<uint32_t>(species), static_cast<uint32_t>(id), tick_);
+    }
+    // the sequential draws of the calling thread come from the engine of this
+    // simulation if it has one (Simulation.rng mode engine with seed), until
+    // the scope is left.
+    rng_engine_scope own_rng() const noexcept
+    {
+      return rng_engine_scope(reng, own_engine_ ? &engine_ : nullptr);
+    }
+
+    row_kernel::kernel_fn row_kernel() const noexcept { return row_kernel_; }
     
-    static float dt() noexcept { return dt_; }      // [s]
+    float dt() const noexcept { return dt_; }      // [s]
 
     tick_t tick() const noexcept { return tick_; }  // [1]
-    static tick_t time2tick(double time) noexcept { return static_cast<tick_t>(time / dt_); }  // [1]
+    tick_t time2tick(double time) const noexcept { return static_cast<tick_t>(time / dt_); }  // [1]
     double time() const noexcept { return static_cast<double>(dt_) * tick_; }                 // [s]
-    static double tick2time(tick_t tick) noexcept { return static_cast<double>(dt_) * tick; } // [s]
+    double tick2time(tick_t tick) const noexcept { return static_cast<double>(dt_) * tick; } // [s]
 
     // returns const reference to population vector that
     template <typename Tag>
@@ -50,10 +118,19 @@ namespace model {
       return std::get<Tag::value>(species_);
     }
 
+    // pos, dir and speed as structure of arrays, as of the end of the last tick.
+    // the agents themselves may be ahead during the update pass.
+    template <typename Tag>
+    const kinematics& kin() const noexcept
+    {
+      return std::get<Tag::value>(state_).kin;
+    }
+
     // returns exclusive neighborhood sorted by distance
     template <typename Tag, typename OtherTag = Tag>
     neighbor_info_view sorted_view(size_t idx) const noexcept
     {
+      static_assert(has_neighbors<Tag::value, OtherTag::value>, "species pair not declared in neighbor_species");
       return sorted_view_impl<Tag::value, OtherTag::value>(idx);
     }
 
@@ -61,9 +138,97 @@ namespace model {
     template <typename Tag, typename OtherTag = Tag>
     neighbor_info_view raw_view(size_t idx) const noexcept
     {
+      static_assert(has_neighbors<Tag::value, OtherTag::value>, "species pair not declared in neighbor_species");
       return raw_view_impl<Tag::value, OtherTag::value>(idx);
     }
 
+    // k nearest agents of species OtherTag, nearest first.
+    // served from the sorted neighborhood if there is one, from the cell-list
+    // of species OtherTag otherwise. in the latter case only dist2 and idx
+    // are set and the view refers to buf.
+    template <typename Tag, typename OtherTag>
+    neighbor_info_view nearest_k(size_t idx, size_t k, std::vector<neighbor_info>& buf) const
+    {
+      return nearest_impl<Tag::value, OtherTag::value>(idx, k, buf);
+    }
+
+    // nearest agent of species OtherTag, empty if there is none.
+    // valid until the next call from the same thread.
+    template <typename Tag, typename OtherTag>
+    neighbor_info_view nearest(size_t idx) const
+    {
+      thread_local std::vector<neighbor_info> buf;
+      return nearest_impl<Tag::value, OtherTag::value>(idx, 1, buf);
+    }
+
+    // counters of the coherent neighbor search
+    template <typename Tag>
+    coherent_stats coherent_neighbor_stats() const noexcept
+    {
+      return std::get<Tag::value>(state_).coherent.stats();
+    }
+
+    // counters of the update scheduler
+    template <typename Tag>
+    const schedule_stats& update_schedule_stats() const noexcept
+    {
+      return std::get<Tag::value>(state_).schedule.stats();
+    }
+
+    // stable external id of agent idx.
+    // the storage order of the agents changes if reordering is enabled.
+    template <typename Tag>
+    size_t id_of(size_t idx) const noexcept
+    {
+      return std::get<Tag::value>(state_).id[idx];
+    }
+
+    // current index of the agent with external id
+    template <typename Tag>
+    size_t idx_of(size_t id) const noexcept
+    {
+      return std::get<Tag::value>(state_).index[id];
+    }
+
+    // indices of the active agents, ascending.
+    // inactive agents are not updated, not integrated, invisible to
+    // the neighbor search and not part of any flock.
+    template <typename Tag>
+    const std::vector<unsigned>& active() const noexcept
+    {
+      return std::get<Tag::value>(state_).active;
+    }
+
+    template <typename Tag>
+    bool is_active(size_t idx) const noexcept
+    {
+      return std::get<Tag::value>(state_).update_times[idx] != static_cast<tick_t>(-1);
+    }
+
+    // (de)activates agent idx, internally synchronized.
+    // an activated agent is updated in the next tick.
+    // not to be called from agent updates.
+    template <typename Tag>
+    void set_active(size_t idx, bool active)
+    {
+      std::lock_guard<std::recursive_mutex> _(mutex_);
+      auto& st = std::get<Tag::value>(state_);
+      if (is_active<Tag>(idx) == active) return;
+      const auto it = std::lower_bound(st.active.begin(), st.active.end(), static_cast<unsigned>(idx));
+      if (active) {
+        st.active.insert(it, static_cast<unsigned>(idx));
+        st.update_times[idx] = tick_;
+      }
+      else {
+        st.active.erase(it);
+        st.update_times[idx] = static_cast<tick_t>(-1);
+        for (auto& nn : st.NN) nn[idx] = 0;
+      }
+      st.grid.clear();              // outdated until the next tick
+      st.schedule.invalidate();
+      active_changed_ = true;
+    }
+
     template <typename Tag>
     const std::vector<flock_descr>& flocks() const noexcept
     {
@@ -82,16 +247,46 @@ namespace model {
       return std::get<Tag::value>(state_).flock_tracker.id_of(idx);
     }
 
+    // polarization and oriented bounding box of flock_id, computed on demand
+    template <typename Tag>
+    model::flock_shape flock_shape(size_t flock_id) const
+    {
+      return std::get<Tag::value>(state_).flock_tracker.shape(static_cast<int>(flock_id));
+    }
+
+    // flocks at the thresholds flockDetection.hierarchy, see flock_hierarchy
+    template <typename Tag>
+    const model::flock_hierarchy& flock_levels() const noexcept
+    {
+      return std::get<Tag::value>(state_).flock_hierarchy;
+    }
+
+    // persistent id of flock_id, see flock_tracker::cluster
+    template <typename Tag>
+    unsigned flock_uid(size_t flock_id) const
+    {
+      return std::get<Tag::value>(state_).flock_tracker.uid(static_cast<int>(flock_id));
+    }
+
+    // flock births, deaths, splits and merges of the last clustering pass
+    template <typename Tag>
+    const std::vector<flock_event>& flock_events() const noexcept
+    {
+      return std::get<Tag::value>(state_).flock_tracker.events();
+    }
+
+    // member indices of flock_id, ascending. valid until the next clustering or reordering
+    template <typename Tag>
+    std::span<const unsigned> flock_members(size_t flock_id) const noexcept
+    {
+      return std::get<Tag::value>(state_).flock_tracker.members(static_cast<int>(flock_id));
+    }
+
     template <typename Tag>
     std::vector<int> flock_mates(size_t flock_id) const
     {
-      auto fm = std::vector<int>{};
-      for (size_t i = 0; i < state_[Tag::value].flock_tracker.pop_size(); ++i) {
-        if (flock_of<Tag>(i) == flock_id) {
-          fm.push_back(static_cast<int>(i));
-        }
-      }
-      return fm;
+      const auto fm = flock_members<Tag>(flock_id);
+      return std::vector<int>(fm.begin(), fm.end());
     }
 
     // Access from foreign threads
@@ -99,27 +294,53 @@ namespace model {
     void terminate() const noexcept { terminate_.store(true, std::memory_order_release); }
     bool terminated() const noexcept { return terminate_.load(std::memory_order_acquire); }
 
-    // calls fun for all individuals, internally synchronized
+    // why the run has ended ("Tmax", "terminated", see model/stop_criteria.hpp),
+    // set by run_job before Finished
+    const std::string& stop_reason() const noexcept { return stop_reason_; }
+    void set_stop_reason(std::string reason) { stop_reason_ = std::move(reason); }
+
+    // calls fun for all individuals in external id order, internally synchronized
     template <typename Tag, typename Fun>
     size_t visit_all(Fun&& fun) const
     {
       std::lock_guard<std::recursive_mutex> _(mutex_);
       auto& pop = std::get<Tag::value>(species_);
+      const auto& index = std::get<Tag::value>(state_).index;
       size_t n = 0;
-      for (size_t i = 0; i < pop.size(); ++i) {
+      for (size_t id = 0; id < pop.size(); ++id) {
+        const auto i = index[id];
         fun(pop[i], i); ++n;
       }
       return n;
     }
 
-    // calls fun for all individuals, internally synchronized
+    // calls fun for all active individuals in external id order, internally synchronized
+    template <typename Tag, typename Fun>
+    size_t visit_active(Fun&& fun) const
+    {
+      std::lock_guard<std::recursive_mutex> _(mutex_);
+      auto& pop = std::get<Tag::value>(species_);
+      const auto& st = std::get<Tag::value>(state_);
+      size_t n = 0;
+      for (size_t id = 0; id < pop.size(); ++id) {
+        const auto i = st.index[id];
+        if (st.update_times[i] != static_cast<tick_t>(-1)) {
+          fun(pop[i], i); ++n;
+        }
+      }
+      return n;
+    }
+
+    // calls fun for all individuals in external id order, internally synchronized
     template <typename Tag, typename Fun>
     size_t visit(Fun&& fun) const
     {
       std::lock_guard<std::recursive_mutex> _(mutex_);
       auto& pop = std::get<Tag::value>(species_);
+      const auto& index = std::get<Tag::value>(state_).index;
       size_t n = 0;
-      for (size_t i = 0; i < pop.size(); ++i) {
+      for (size_t id = 0; id < pop.size(); ++id) {
+        const auto i = index[id];
         if (std::get<Tag::value>(state_).update_times[i] != static_cast<tick_t>(-1)) {
           fun(pop[i]); ++n;
         }
@@ -144,9 +365,10 @@ namespace model {
     template <size_t S1, size_t S2>
     neighbor_info_view sorted_view_impl(size_t idx) const noexcept
     {
-      const auto n = state_[S2].update_times.size();
-      const auto first = &state_[S1].SNI[S2][idx * n];
+      const auto first = state_[S1].SNI[S2].data() + idx * state_[S1].stride[S2];
+      const auto n = state_[S1].NN[S2][idx];
       if constexpr (S1 == S2) {
+        if (n == 0) return neighbor_info_view{};
         return neighbor_info_view{ first + 1, n - 1 };    // omit 'self' 
       }
       else {
@@ -158,31 +380,90 @@ namespace model {
     template <size_t S1, size_t S2>
     neighbor_info_view raw_view_impl(size_t idx) const noexcept
     {
-      const auto n = state_[S2].update_times.size();
-      const auto first = &state_[S1].RNI[S2][idx * n];
-      return neighbor_info_view{ first, n };
+      const auto first = state_[S1].RNI[S2].data() + idx * state_[S1].stride[S2];
+      return neighbor_info_view{ first, state_[S1].NN[S2][idx] };
+    }
+
+    template <size_t S1, size_t S2>
+    neighbor_info_view nearest_impl(size_t idx, size_t k, std::vector<neighbor_info>& buf) const
+    {
+      if (state_[S1].stride[S2] != 0) {
+        const auto sv = sorted_view_impl<S1, S2>(idx);
+        return neighbor_info_view{ sv.begin(), std::min(k, sv.size()) };
+      }
+      const auto& pos = std::get<S1>(species_)[idx].pos;
+      const auto& kinj = state_[S2].kin;
+      const auto& active = state_[S2].active;
+      const auto& grid = state_[S2].grid;
+      const auto skip = [idx](unsigned j) { return S1 == S2 && j == idx; };
+      // the grid is outdated before the first update
+      if (active.size() > nearest_linear_max && grid.size() == active.size()) {
+        const auto n = grid.knn(pos, k, std::numeric_limits<float>::infinity(), buf, skip);
+        return neighbor_info_view{ buf.data(), n };
+      }
+      buf.clear();
+      for (const auto j : active) {
+        if (!skip(j)) buf.push_back(neighbor_info{ glm::distance2(pos, kinj.pos(j)), j });
+      }
+      const auto n = std::min(k, buf.size());
+      std::partial_sort(buf.begin(), buf.begin() + n, buf.end(), [](const auto& a, const auto& b) { return a.dist2 < b.dist2; });
+      return neighbor_info_view{ buf.data(), n };
     }
 
+    // nearest() scans species with up to this many active agents instead of using the grid
+    static constexpr size_t nearest_linear_max = 64;
+
+    void checkpoint_io(archive& ar);
+
   private:
+    float dt_ = 0.f;
     tick_t tick_ = 0;
     tick_t flock_update_ = 0;
     tick_t flock_interval_ = 0;
     float flock_dd_ = 0.f;
-
+    tick_t reorder_update_ = 0;
+    tick_t reorder_interval_ = 0;     // 0: no reordering
+    sfc_order::Curve reorder_curve_ = sfc_order::Curve::Hilbert;
+    bool active_changed_ = false;     // set_active() since the last update
+    bool concurrent_species_ = true;  // species phases as concurrent tasks
+    bool counter_rng_ = false;        // per agent rng streams
+    std::uint64_t rng_seed_ = 0;
+    bool own_engine_ = false;         // engine_ instead of the thread's engine
+    mutable rndutils::default_engine engine_;
+    neighbor_search_t ns_;
+    row_kernel::kernel_fn row_kernel_ = &row_kernel::scalar;
+    std::uint64_t esc_mask_ = 0;      // bit s: s in esc_states_
+    json restart_;                    // species config by name, see restore
 
     mutable std::atomic<int> force_ni_update_ = 0;       // forced neighbor info update every tick if > 0
     mutable std::recursive_mutex mutex_;                 // simulation lock
     mutable species_pop species_;
     mutable std::atomic<bool> terminate_ = false;
+    std::string stop_reason_;
 
     struct state_t
     {
       size_t size()const noexcept { return update_times.size(); }
-      std::vector<tick_t> update_times;
+      std::vector<tick_t> update_times;                        // -1: inactive
+      std::vector<unsigned> active;                            // indices of active agents, ascending
+      due_schedule schedule;                                   // agents by update time
+      std::vector<unsigned> id;                                // external id by index
+      std::vector<unsigned> index;                             // index by external id
       std::vector<float> stress;
+      kinematics kin;                                          // hot state mirror
       std::array<std::vector<neighbor_info>, n_species> SNI;   // sorted neighbor info matrices
       std::array<std::vector<neighbor_info>, n_species> RNI;   // raw neighbor info matrices
+      std::array<std::vector<unsigned>, n_species> NN;         // number of valid entries per matrix row
+      std::array<size_t, n_species> stride;                    // matrix row length, N or K (bounded)
+      neighbor_grid grid;                                      // cell-list over this species (Grid backend)
+      std::vector<coherent_info> coherence;                    // per agent (coherent)
+      std::vector<unsigned> prev_idx;                          // SNI[S] indices as of the last tick (coherent)
+      std::vector<unsigned> prev_nn;                           // NN[S] as of the last tick (coherent)
+      motion_bound motion;                                     // (coherent)
+      coherent_counter coherent;                               // (coherent)
       flock_tracker flock_tracker;
+      model::flock_hierarchy flock_hierarchy;                  // (flockDetection.hierarchy)
+      sfc_order order;                                         // (reorder)
     };
     mutable std::array<state_t, n_species> state_;
     friend class flock_tracker;
@@ -191,6 +472,12 @@ namespace model {
      using state_array = decltype(state_);
      std::vector<int> esc_states_; // which states are escapes and copyable
 
+     bool is_esc_state(int state) const noexcept
+     {
+       if (state >= 0 && state < 64) return (esc_mask_ >> state) & 1;
+       return std::find(esc_states_.begin(), esc_states_.end(), state) != esc_states_.end();
+     }
+
    };
 
 }
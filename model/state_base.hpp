@@ -2,6 +2,7 @@
 #define MODEL_STATES_BASE_HPP_INCLUDED
 
 #include <model/simulation.hpp>
+#include <model/action_base.hpp>
 #include <model/flight.hpp>
 
 
@@ -20,6 +21,7 @@ namespace model {
       virtual void enter(agent_type* self, size_t idx, tick_t T, const Simulation& sim) = 0;
       virtual void check_state_entry(agent_type* self, size_t idx, tick_t T, const Simulation& sim) = 0;
       virtual void resume(agent_type* self, size_t idx, tick_t T, const Simulation& sim) = 0;
+      virtual void checkpoint(archive& ar) = 0;     // run state incl. actions
     };
 
 
@@ -35,11 +37,11 @@ namespace model {
       using package_array = std::array<std::unique_ptr<base_type>, size>;
       using transition_matrix = std::array<std::array<float, size>, size>;
 
-      static package_array create(size_t idx, const json& J)
+      static package_array create(size_t idx, const json& J, const Simulation& sim)
       {
         package_array a;
         if (J.size() != size) throw std::runtime_error("Parsing error: Number of states differs in code and config  \n");
-        do_create<0>::apply(a, idx, J);
+        do_create<0>::apply(a, idx, J, sim);
         return a;
       }
 
@@ -48,13 +50,13 @@ namespace model {
       struct do_create
       {
         template <typename Json>
-        static void apply(package_array& a, size_t idx, const Json& J)
+        static void apply(package_array& a, size_t idx, const Json& J, const Simulation& sim)
         {
           using type = std::tuple_element_t<I, package_tuple>;
           //assert(J[I]["name"] == type::name());
           if (J[I]["name"] != type::name()) throw std::runtime_error("Parsing error: Name of state differs in code (" + std::string(type::name()) + ") and config (" + std::string(J[I]["name"])+ ")  \n");
-          a[I].reset(new type(idx, J[I]));
-          do_create<I + 1>::apply(a, idx, J);
+          a[I].reset(new type(idx, J[I], sim));
+          do_create<I + 1>::apply(a, idx, J, sim);
         }
       };
 
@@ -62,7 +64,7 @@ namespace model {
       struct do_create<size>
       {
         template <typename J>
-        static void apply(package_array&, size_t, const J&) {}
+        static void apply(package_array&, size_t, const J&, const Simulation&) {}
       };
     };
 
@@ -83,7 +85,9 @@ protected: \
   template <size_t I> \
   void chain_actions(agent_type* self, size_t idx, tick_t T, const Simulation& sim) \
   { \
-    std::get<I>(actions)(self, idx, T, sim); \
+    if constexpr (I == 0 && action_pack::fused) action_pack::walk(actions, self, idx, sim); \
+    if constexpr (action_pack::fused && ::model::actions::is_fusable<std::tuple_element_t<I, action_tuple>>) std::get<I>(actions).end(self); \
+    else std::get<I>(actions)(self, idx, T, sim); \
     chain_actions<I + 1>(self, idx, T, sim); \
   } \
   template <> \
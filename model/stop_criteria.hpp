@@ -0,0 +1,152 @@
+#ifndef MODEL_STOP_CRITERIA_HPP_INCLUDED
+#define MODEL_STOP_CRITERIA_HPP_INCLUDED
+
+#include <cmath>
+#include <deque>
+#include <chrono>
+#include <vector>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <model/json.hpp>
+#include <agents/agents.hpp>
+#include <model/simulation.hpp>
+
+
+namespace model {
+
+
+  // early termination, config key Simulation.stopWhen, all keys optional:
+  //
+  //   "stopWhen": {
+  //     "window": 30,              [s] observation window, required by the windowed criteria below
+  //     "polarizationVar": 1e-4,   steady: variance of the polarization within the window below,
+  //     "stableFlocks": 1,         and the number of flocks unchanged within the window,
+  //     "predatorDistance": 100,   and no predator closer than [m] to any starling
+  //     "fragmented": 0.1,         largest flock below this fraction of the starlings throughout the window
+  //     "wallClock": 3600          [s] run time budget
+  //   }
+  //
+  // polarization is the size weighted mean of the starling flocks' polarization.
+  // evaluated after every tick from the flock descriptors; the predator
+  // distance only if the rest of the steady criteria holds.
+  class stop_criteria
+  {
+  public:
+    stop_criteria() = default;
+
+    explicit stop_criteria(const json& J)
+    {
+      if (!J["Simulation"].contains("stopWhen")) return;
+      const auto& js = J["Simulation"]["stopWhen"];
+      enabled_ = true;
+      window_ = js.value("window", 0.0);
+      pol_var_ = js.value("polarizationVar", -1.0);
+      stable_flocks_ = 0 != js.value("stableFlocks", 0);
+      pred_dist2_ = js.contains("predatorDistance") ? std::pow(double(js["predatorDistance"]), 2.0) : -1.0;
+      fragmented_ = js.value("fragmented", -1.0);
+      wall_clock_ = js.value("wallClock", -1.0);
+      if ((pol_var_ >= 0.0 || stable_flocks_ || fragmented_ >= 0.0) && !(window_ > 0.0)) {
+        throw std::runtime_error("stopWhen: 'polarizationVar', 'stableFlocks' and 'fragmented' require positive 'window'");
+      }
+    }
+
+    bool enabled() const noexcept { return enabled_; }
+
+    // starts the wall clock and the observation windows
+    void start(const Simulation& sim)
+    {
+      t0_ = std::chrono::steady_clock::now();
+      pol_.clear();
+      pol_sum_ = pol_sum2_ = 0.0;
+      started_ = -1.0;
+      nflocks_ = static_cast<size_t>(-1);
+      flocks_since_ = frag_since_ = sim.time();
+    }
+
+    // the reason to stop after the last tick, nullptr to go on
+    const char* operator()(const Simulation& sim)
+    {
+      if (!enabled_) return nullptr;
+      const auto t = sim.time();
+      if (wall_clock_ >= 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - t0_).count() > wall_clock_) {
+        return "wall clock";
+      }
+      const auto& flocks = sim.flocks<starling_tag>();
+      if (flocks.empty()) return nullptr;     // not clustered yet
+      size_t n = 0, largest = 0;
+      for (const auto& f : flocks) {
+        n += f.size;
+        largest = std::max(largest, f.size);
+      }
+      if (started_ < 0.0) started_ = t;
+      if (pol_var_ >= 0.0) {
+        // the shapes are computed on demand, only if asked for
+        double pol = 0.0;
+        for (size_t i = 0; i < flocks.size(); ++i) {
+          pol += sim.flock_shape<starling_tag>(i).pol * flocks[i].size;
+        }
+        pol /= std::max(n, size_t(1));
+        pol_.emplace_back(t, pol);
+        pol_sum_ += pol;
+        pol_sum2_ += pol * pol;
+        while (pol_.front().first < t - window_) {
+          pol_sum_ -= pol_.front().second;
+          pol_sum2_ -= pol_.front().second * pol_.front().second;
+          pol_.pop_front();
+        }
+      }
+      if (flocks.size() != nflocks_) {
+        nflocks_ = flocks.size();
+        flocks_since_ = t;
+      }
+      if (fragmented_ < 0.0 || largest >= fragmented_ * n) frag_since_ = t;
+      const auto full = (t - started_) >= window_;
+      if (!full) return nullptr;
+      if (fragmented_ >= 0.0 && (t - frag_since_) >= window_) return "fragmented";
+      if (pol_var_ < 0.0 && !stable_flocks_) return nullptr;    // no steady criteria
+      if (pol_var_ >= 0.0) {
+        const auto m = pol_sum_ / pol_.size();
+        if (pol_sum2_ / pol_.size() - m * m >= pol_var_) return nullptr;
+      }
+      if (stable_flocks_ && (t - flocks_since_) < window_) return nullptr;
+      if (pred_dist2_ >= 0.0 && predator_in_range(sim)) return nullptr;
+      return "steady state";
+    }
+
+  private:
+    bool predator_in_range(const Simulation& sim)
+    {
+      const auto& prey = sim.kin<starling_tag>();
+      const auto& pred = sim.kin<pred_tag>();
+      d2_.resize(prey.size());
+      for (const auto p : sim.active<pred_tag>()) {
+        prey.distance2(pred.pos(p), d2_.data());
+        for (const auto i : sim.active<starling_tag>()) {
+          if (d2_[i] < pred_dist2_) return true;
+        }
+      }
+      return false;
+    }
+
+    bool enabled_ = false;
+    double window_ = 0.0;           // [s]
+    double pol_var_ = -1.0;
+    bool stable_flocks_ = false;
+    double pred_dist2_ = -1.0;      // [m^2]
+    double fragmented_ = -1.0;
+    double wall_clock_ = -1.0;      // [s]
+
+    std::chrono::steady_clock::time_point t0_;
+    double started_ = -1.0;         // [s] first sample
+    std::deque<std::pair<double, double>> pol_;   // (time, polarization) within the window
+    double pol_sum_ = 0.0, pol_sum2_ = 0.0;
+    size_t nflocks_ = static_cast<size_t>(-1);
+    double flocks_since_ = 0.0;     // [s] flock count unchanged since
+    double frag_since_ = 0.0;       // [s] fragmented since
+    std::vector<float> d2_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <agents/agents.hpp>
+#include <model/simulation.hpp>
+#include <model/checkpoint.hpp>
+#include <model/batch.hpp>
+#include <model/warm_cache.hpp>
+
+
+namespace model {
+
+  // what doesn't touch the simulation state up to 'time'
+  const std::vector<std::string> warm_cache::default_exclude = {
+    "/Simulation/Tmax",
+    "/Simulation/speedup",
+    "/Simulation/terrain",
+    "/Simulation/numThreads",
+    "/Simulation/Analysis",
+    "/Simulation/checkpoint",
+    "/Simulation/stopWhen",
+    "/Simulation/warmStart",
+    "/Simulation/restart",
+    "/Sky"
+  };
+
+
+  warm_cache::warm_cache(const json& J) :
+    exclude_(default_exclude)
+  {
+    if (!J["Simulation"].contains("warmStart")) return;
+    const auto& jw = J["Simulation"]["warmStart"];
+    dir_ = std::string(jw["dir"]);
+    time_ = jw["time"];
+    if (jw.contains("exclude")) {
+      const auto more = jw["exclude"].get<std::vector<std::string>>();
+      exclude_.insert(exclude_.end(), more.cbegin(), more.cend());
+    }
+    std::filesystem::create_directories(dir_);
+  }
+
+
+  std::uint64_t warm_cache::hash(const json& J) const
+  {
+    auto sub = json::array({ J, time_, archive::version });
+    for (const auto& k : exclude_) {
+      const auto ptr = json::json_pointer(k);
+      if (sub[0].contains(ptr)) sub[0][ptr] = nullptr;
+    }
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (const auto c : sub.dump()) {
+      h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+    return h;
+  }
+
+
+  std::shared_ptr<const std::vector<char>> warm_cache::get(const json& J, std::filesystem::path* stored)
+  {
+    const auto h = hash(J);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.warm", static_cast<unsigned long long>(h));
+    const auto file = dir_ / name;
+    std::shared_ptr<tbb::collaborative_once_flag> busy;
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      auto& b = busy_[h];
+      if (!b) b = std::make_shared<tbb::collaborative_once_flag>();
+      busy = b;
+    }
+    std::shared_ptr<const std::vector<char>> bp;
+    tbb::collaborative_call_once(*busy, [&] {
+      if (std::filesystem::exists(file)) return;
+      auto sim = std::make_unique<Simulation>(J);
+      auto job = batch_job{ sim.get(), nullptr, sim->time2tick(time_) };
+      run_job(job);
+      if (job.error) std::rethrow_exception(job.error);
+      bp = std::make_shared<const std::vector<char>>(sim->branch_point());
+      write_checkpoint(file, *bp);
+      if (stored) *stored = file;
+    });
+    if (!bp) bp = std::make_shared<const std::vector<char>>(read_checkpoint(file));
+    return bp;
+  }
+
+}
@@ -0,0 +1,53 @@
+#ifndef MODEL_WARM_CACHE_HPP_INCLUDED
+#define MODEL_WARM_CACHE_HPP_INCLUDED
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include <tbb/collaborative_call_once.h>
+#include <model/json.hpp>
+
+
+namespace model {
+
+
+  // on-disk cache of warmed-up simulation states, config key Simulation.warmStart:
+  //
+  //   "warmStart": { "dir": "warm_cache", "time": 100, "exclude": [ "/Pred/states", ... ] }
+  //
+  // an entry is the branch point (see Simulation::branch_point) of a simulation
+  // run up to 'time' [s], keyed by the hash of the whole config without the
+  // values at the json pointers default_exclude and 'exclude'. configs that
+  // differ only there share the entry.
+  class warm_cache
+  {
+  public:
+    static const std::vector<std::string> default_exclude;
+
+    explicit warm_cache(const json& J);
+
+    bool enabled() const noexcept { return !dir_.empty(); }
+
+    // the entry for J, from disk or by running J up to 'time'.
+    // a key is computed once per process, concurrent callers help with it.
+    // stored is set to the file if this call has computed the entry.
+    std::shared_ptr<const std::vector<char>> get(const json& J, std::filesystem::path* stored = nullptr);
+
+    // FNV-1a hash of J without the excluded values
+    std::uint64_t hash(const json& J) const;
+
+  private:
+    std::filesystem::path dir_;
+    double time_ = 0.0;
+    std::vector<std::string> exclude_;
+    std::mutex mutex_;
+    std::map<std::uint64_t, std::shared_ptr<tbb::collaborative_once_flag>> busy_;   // per key
+  };
+
+}
+
+#endif
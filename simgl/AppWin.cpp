@@ -97,7 +97,7 @@ void AppWin::send_flush_message(const model::Simulation& sim)
 void AppWin::notify_tick(const model::Simulation& sim)
 {
   send_flush_message(sim);
-  game_throttle_.tick(std::chrono::duration<double>(model::Simulation::dt()), [&]() {
+  game_throttle_.tick(std::chrono::duration<double>(sim.dt()), [&]() {
     if (flush_) {
       send_flush_message(sim);
     }
@@ -221,6 +221,15 @@ LRESULT AppWin::OnKeyDown(UINT, WPARAM wParam, LPARAM lParam, BOOL& bHandled)
     break;
   }
 
+  case 'K': {
+    // kills all predators or revives them if none is alive
+    const auto alive = sim_->visit_active<model::pred_tag>([](const auto&, size_t) {});
+    for (size_t i = 0; i < sim_->pop<model::pred_tag>().size(); ++i) {
+      sim_->set_active<model::pred_tag>(i, alive == 0);
+    }
+    break;
+  }
+
   case 'P': {
     //sim_->visit<model::pred_tag>([](auto& p) {
     //  std::cout << p.get_current_state() << ' ';
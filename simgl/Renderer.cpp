@@ -655,12 +655,16 @@ namespace {
     }));
     auto& follow = self->follow();
     if (follow.species == I && follow.idx >= 0) {
+      // instances are in external id order
+      const auto idx = sim.idx_of<Tag>(follow.idx);
       if (follow.flock) {
-        auto flockId = sim.flock_of<Tag>(follow.idx);
-        follow.eye = sim.flock_info<Tag>(flockId).gc();
+        auto flockId = sim.flock_of<Tag>(idx);
+        if (flockId >= 0 && static_cast<size_t>(flockId) < sim.flocks<Tag>().size()) {
+          follow.eye = sim.flock_shape<Tag>(flockId).gc();
+        }
       }
       else {
-        follow.eye = sim.pop<Tag>()[follow.idx].pos;
+        follow.eye = sim.pop<Tag>()[idx].pos;
       }
     }
     flush_species<I + 1>(self, sim, gls);
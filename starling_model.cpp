@@ -1,11 +1,17 @@
 #include <filesystem>
 #include <iostream>
+#include <fstream>
 #include <future>
 #include <thread>
+#include <mutex>
+#include <set>
+#include <charconv>
 #include <tbb/tbb.h>
 #include <tbb/global_control.h>
 #include <model/json.hpp>
 #include <model/model.hpp>
+#include <model/batch.hpp>
+#include <model/warm_cache.hpp>
 #ifdef _WIN32
 #include <simgl/AppWin.h>
 #endif
@@ -13,6 +19,63 @@
 #include <libs/cmd_line.h>
 
 
+unsigned num_threads(const json& J)
+{
+  unsigned numThreads = J["Simulation"]["numThreads"];
+  if (numThreads == -1) numThreads = std::thread::hardware_concurrency();
+  return std::clamp(numThreads, 1u, std::thread::hardware_concurrency());
+}
+
+
+// optional config key Simulation.checkpoint.
+// the output folder of a run is recorded in <file>.out
+void checkpoint_settings(model::batch_job& job, const json& J, const std::string& suffix = "")
+{
+  if (!J["Simulation"].contains("checkpoint")) return;
+  const auto& jc = J["Simulation"]["checkpoint"];
+  job.checkpoint = std::string(jc["file"]) + suffix;
+  job.checkpoint_interval = job.sim->time2tick(double(jc["interval"]));
+  job.resume = jc.contains("resume") && (0 != int(jc["resume"]));
+  const auto& ja = J["Simulation"]["Analysis"];
+  if (!(job.resume && std::filesystem::exists(job.checkpoint)) && ja.contains("output_path")) {
+    std::ofstream(std::filesystem::path(job.checkpoint) += ".out") << ja["output_path"].get<std::string>() << '\n';
+  }
+}
+
+
+// a run resumed from its checkpoint writes on into the output folder of
+// the interrupted run, see checkpoint_settings. call before the observers
+// are created.
+void resume_output(json& J, const std::string& suffix = "")
+{
+  if (!J["Simulation"].contains("checkpoint")) return;
+  const auto& jc = J["Simulation"]["checkpoint"];
+  const auto file = std::filesystem::path(std::string(jc["file"]) + suffix);
+  if (!(jc.contains("resume") && (0 != int(jc["resume"]))) || !std::filesystem::exists(file)) return;
+  std::string path;
+  if (std::ifstream is(std::filesystem::path(file) += ".out"); is && std::getline(is, path) && std::filesystem::is_directory(path)) {
+    J["Simulation"]["Analysis"]["resume_path"] = path;
+  }
+}
+
+
+// a branch of a forked sweep: the species whose initial conditions the
+// patch sets start over at the branch point, see Simulation::restore.
+// the rng seed, unless the patch sets it, is mixed with the line.
+void branch_settings(json& J, const json& patch, size_t line)
+{
+  for (const auto& [name, jp] : patch.items()) {
+    if (name != "Simulation" && jp.is_object() && jp.contains("InitCondit")) {
+      J["Simulation"]["restart"].push_back(name);
+    }
+  }
+  const auto seed = json::json_pointer("/Simulation/rng/seed");
+  if (J.contains(seed) && !patch.contains(seed)) {
+    J[seed] = model::philox::branch_seed(J[seed].get<uint64_t>(), line);
+  }
+}
+
+
 // model thread function
 void run_simulation(model::Simulation* sim, 
                     const species_snapshots& ss,
@@ -21,22 +84,30 @@ void run_simulation(model::Simulation* sim,
                     const json& J)
 {
   try {
-    unsigned numThreads = J["Simulation"]["numThreads"];
-    if (numThreads == -1) numThreads = std::thread::hardware_concurrency();
-    numThreads = std::clamp(numThreads, 1u, std::thread::hardware_concurrency());
+    const auto numThreads = num_threads(J);
     tbb::global_control tbbgc(tbb::global_control::max_allowed_parallelism, numThreads); 
-    auto Tmax = sim->time2tick(double(J["Simulation"]["Tmax"]));
-    sim->initialize(observer, ss);
-    while (!sim->terminated()) {
-      sim->update(observer);
-      if (sim->tick() == Tmax) {
-        break;
-      }
+    auto jobs = std::vector<model::batch_job>(1);
+    jobs[0] = { sim, observer, sim->time2tick(double(J["Simulation"]["Tmax"])), ss };
+    checkpoint_settings(jobs[0], J);
+    jobs[0].stop = model::stop_criteria(J);
+    if (auto warm = model::warm_cache(J); warm.enabled() && std::get<0>(ss).empty()) {
+      std::filesystem::path stored;
+      jobs[0].branch_point = warm.get(J, &stored);
+      if (!stored.empty()) std::cout << "warm start: cached " << stored.string() << '\n';
+    }
+    model::run_batch(jobs, numThreads);
+    if (jobs[0].error) std::rethrow_exception(jobs[0].error);
+    std::cout << "finished at t = " << sim->time() << " s: " << sim->stop_reason() << '\n';
+    if (sim->neighbor_search().coherent) {
+      const auto cs = sim->coherent_neighbor_stats<model::starling_tag>();
+      std::cout << "coherent neighbor search: " << cs.rebuilds << " of " << (cs.incremental + cs.rebuilds) << " starling updates fell back to full search\n";
+    }
+    const auto us = sim->update_schedule_stats<model::starling_tag>();
+    if (us.ticks) {
+      std::cout << "update scheduler: " << double(us.due) / us.ticks << " starlings due per tick (max " << us.max_due << "), " << 1000.0 * us.seconds << " ms overhead\n";
     }
-    observer->notify(model::Simulation::Finished, *sim);
   }
   catch (std::exception& err) {
-    observer->notify(model::Simulation::Finished, *sim);
     std::cerr << err.what() << '\n';
   }
 }
@@ -49,9 +120,102 @@ const static species_snapshots initial_snapshot = {
 };
 
 
+// parameter sweep: one run per non-empty line of the manifest, each line
+// a json merge patch (RFC 7386) onto J. runs share one thread pool.
+// finished runs are appended to <manifest>.journal as 'line<tab>output_path<tab>stop_reason'
+// and skipped when the sweep is started again.
+// fork > 0: J is run up to fork [s] once, the runs branch from there.
+// otherwise the runs start from the warm start cache if configured in J.
+void run_sweep(const json& J, const std::filesystem::path& manifest, double fork)
+{
+  std::vector<std::pair<size_t, std::string>> pending;    // parsed by the run, errors are per line
+  auto journal_path = manifest;
+  journal_path += ".journal";
+  std::set<size_t> done;
+  bool torn = false;      // last entry without line end
+  if (std::ifstream is(journal_path); is) {
+    for (std::string line; std::getline(is, line); ) {
+      torn = is.eof();
+      if (line.empty()) continue;
+      size_t n = 0;
+      const auto res = std::from_chars(line.data(), line.data() + line.size(), n);
+      if (res.ec == std::errc{} && res.ptr != line.data() + line.size() && *res.ptr == '\t') done.insert(n);
+      else std::cerr << "sweep: skipping journal entry '" << line << "'\n";   // interrupted write
+    }
+  }
+  std::ifstream is(manifest);
+  if (!is) throw std::runtime_error("can't open sweep manifest " + manifest.string());
+  size_t lines = 0;
+  for (std::string line; std::getline(is, line); ) {
+    ++lines;
+    if (line.find_first_not_of(" \t\r") == line.npos || done.count(lines)) continue;
+    pending.emplace_back(lines, line);
+  }
+  std::cout << "sweep: " << pending.size() << " runs pending, " << done.size() << " done\n";
+
+  std::ofstream journal(journal_path, std::ios::app);
+  if (torn) journal << std::endl;
+  std::mutex journal_mutex;
+  size_t finished = 0;
+  const auto numThreads = num_threads(J);
+  tbb::global_control tbbgc(tbb::global_control::max_allowed_parallelism, numThreads);
+  auto arena = tbb::task_arena(numThreads);
+  auto warm_start = model::warm_cache(J);
+  arena.execute([&] {
+    std::shared_ptr<const std::vector<char>> branch_point;
+    if (fork > 0.0 && !pending.empty()) {
+      auto warm = std::make_unique<model::Simulation>(J);
+      auto job = model::batch_job{ warm.get(), nullptr, warm->time2tick(fork) };
+      model::run_job(job);
+      if (job.error) std::rethrow_exception(job.error);
+      branch_point = std::make_shared<const std::vector<char>>(warm->branch_point());
+      std::cout << "sweep: branching at t = " << warm->time() << " s\n";
+    }
+    tbb::parallel_for_each(pending.begin(), pending.end(), [&](const std::pair<size_t, std::string>& run) {
+      const auto& [line, patch] = run;
+      try {
+        auto Jr = J;
+        const auto jp = json::parse(patch);
+        Jr.merge_patch(jp);
+        if (branch_point) branch_settings(Jr, jp, line);
+        Jr["Simulation"]["Analysis"]["run_id"] = std::to_string(line);
+        resume_output(Jr, "." + std::to_string(line));
+        std::unique_ptr<model::Simulation> sim;
+        tbb::this_task_arena::isolate([&] { sim = std::make_unique<model::Simulation>(Jr); });
+        auto observers = analysis::CreateObserverChain<model::starling_tag>(Jr);
+        auto observer = std::make_unique<Observer>();
+        for (const auto& obs : observers) observer->append_observer(obs.get());
+        auto job = model::batch_job{ sim.get(), observer.get(), sim->time2tick(double(Jr["Simulation"]["Tmax"])) };
+        checkpoint_settings(job, Jr, "." + std::to_string(line));
+        job.stop = model::stop_criteria(Jr);
+        job.branch_point = branch_point;
+        if (!branch_point && warm_start.enabled()) {
+          std::filesystem::path stored;
+          tbb::this_task_arena::isolate([&] { job.branch_point = warm_start.get(Jr, &stored); });
+          if (!stored.empty()) {
+            std::lock_guard<std::mutex> _(journal_mutex);
+            std::cout << "sweep: line " << line << " warm start cached " << stored.string() << '\n';
+          }
+        }
+        model::run_job(job);
+        if (job.error) std::rethrow_exception(job.error);
+        std::lock_guard<std::mutex> _(journal_mutex);
+        journal << line << '\t' << Jr["Simulation"]["Analysis"].value("output_path", "") << '\t' << sim->stop_reason() << std::endl;
+        std::cout << "sweep: line " << line << " done at t = " << sim->time() << " s, " << sim->stop_reason() << " (" << ++finished << " of " << pending.size() << ")\n";
+      }
+      catch (std::exception& err) {
+        std::lock_guard<std::mutex> _(journal_mutex);
+        std::cerr << "sweep: line " << line << " failed: " << err.what() << '\n';
+      }
+    });
+  });
+}
+
+
 void run(json& J, bool headless)
 {
   model::species_snapshots ss = initial_snapshot;
+  resume_output(J);
   for (;;) {
     auto sim = std::make_unique<model::Simulation>(J);
     auto observers = analysis::CreateObserverChain<model::starling_tag>(J);
@@ -114,6 +278,12 @@ int main(int argc, const char* argv[])
     if (exp_files == "true") {
       save_json(J, "composed_config.json");
     }
+    if (std::filesystem::path manifest = ""; clp.optional("sweep", manifest)) {
+      double fork = 0.0;
+      clp.optional("fork", fork);
+      run_sweep(J, manifest, fork);
+      return 0;
+    }
     bool headless = clp.flag("--headless");
 #ifndef _WIN32
     headless = true;
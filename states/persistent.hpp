@@ -14,13 +14,13 @@ namespace model {
       make_state_from_this(persistent);
     
     public:
-      persistent(size_t idx, const json& J) :
-        actions(IP::create(idx, J["actions"])), 
-        duration_(static_cast<tick_t>(double(J["duration"]) / Simulation::dt())) // [tick]
+      persistent(size_t idx, const json& J, const Simulation& sim) :
+        actions(IP::create(idx, J["actions"], sim)), 
+        duration_(static_cast<tick_t>(double(J["duration"]) / sim.dt())) // [tick]
       {
         effective_dur_ = duration_;
 	    	sai_ = flight::create_state_aero<float>(J["aeroState"]);
-        tr_ = std::max(tick_t(1), static_cast<tick_t>(double(J["tr"]) / Simulation::dt())); // [tick]
+        tr_ = std::max(tick_t(1), static_cast<tick_t>(double(J["tr"]) / sim.dt())); // [tick]
         //normalize_actions<0>();
       }
 
@@ -68,6 +68,14 @@ namespace model {
             self->on_state_exit(idx, T, sim);
         }
       };
+
+      void checkpoint(archive& ar) override
+      {
+        ar(t_exit_, effective_dur_);
+        if (ar.parameters()) ar(all_ws, tr_, duration_, sai_);
+        ::model::actions::checkpoint_actions(ar, actions);
+      }
+
     public:
       tick_t t_exit_;
     protected:
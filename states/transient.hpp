@@ -14,11 +14,11 @@ namespace model {
       make_state_from_this(transient);
 
     public:
-      explicit transient(size_t idx, const json& J) :
-        actions(IP::create(idx, J["actions"]))
+      transient(size_t idx, const json& J, const Simulation& sim) :
+        actions(IP::create(idx, J["actions"], sim))
 	    {
 	    	sai_ = flight::create_state_aero<float>(J["aeroState"]);
-        tr_ = std::max(tick_t(1), static_cast<tick_t>(double(J["tr"]) / Simulation::dt())); // [tick]
+        tr_ = std::max(tick_t(1), static_cast<tick_t>(double(J["tr"]) / sim.dt())); // [tick]
         //normalize_actions<0>();
       }
 
@@ -43,6 +43,12 @@ namespace model {
         self->on_state_exit(idx, T, sim);
       };
 
+      void checkpoint(archive& ar) override
+      {
+        if (ar.parameters()) ar(all_ws, tr_, sai_);
+        ::model::actions::checkpoint_actions(ar, actions);
+      }
+
     protected: 
       tick_t tr_;  // [tick]
 	    flight::state_aero<float> sai_; // state specific aero info
@@ -22,7 +22,7 @@ namespace model {
 
       void operator()(agent_type* self, size_t idx, tick_t T, const Simulation& sim)
       {
-        auto ip = sim.sorted_view<Tag, pred_tag>(idx);
+        auto ip = sim.nearest<Tag, pred_tag>(idx);
         if (!ip.empty()) {
             self->stress += w_ * std::exp( - std::sqrt(ip[0].dist2) / shape_);
         }
@@ -53,10 +53,11 @@ namespace model {
       {
         const auto sv = sim.sorted_view<Tag>(idx);
         const auto& flock = sim.pop<Tag>();
+        const auto& kin = sim.kin<Tag>();
 
         float n_str = 0;
         auto realized_topo = while_topo(sv, topo_, [&](const auto& ni) {
-          const auto offs = space::ofs(self->pos, flock[ni.idx].pos);
+          const auto offs = space::ofs(self->pos, kin.pos(ni.idx));
           if (glm::dot(self->dir, offs) > glm::sqrt(ni.dist2) * cfov_)
           {
             n_str += math::smootherstep(flock[ni.idx].stress, 0.f, 1.f);